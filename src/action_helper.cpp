@@ -0,0 +1,144 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* action_helper.cpp */
+
+/* Runs the configured actions as one burst: HTTP requests are sent first,
+ * then all MQTT topics are published over the existing connection while
+ * the HTTP servers work, and finally the HTTP responses are collected.
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "main.h"
+#include "settings.h"
+#include "mqtt_helper.h"
+#include "action_helper.h"
+
+static WiFiClient _http_clients[MAX_ACTIONS];
+static uint32_t _action_start[MAX_ACTIONS];
+static int _action_ms[MAX_ACTIONS]; // -1 if failed or not run
+static bool _http_pending[MAX_ACTIONS];
+
+
+/* Connect & send the HTTP request, without waiting for the response;
+ * the host was looked up with the cache, see build_settings_from_wifi()
+ */
+static bool _http_start(int index, WIFI_SETTINGS_T *data, uint32_t timeout_ms) {
+	ACTION_T *action = &data->actions[index];
+	char host[50];
+	uint16_t port;
+	const char *path;
+	if (!action_parse_url(action->target, "http://", 80, host, sizeof(host), &port, &path)) {
+		DEBUG_LOG("_http_start(): invalid URL");
+		return false;
+	}
+	if (!data->action_ip[index]) return false;
+	IPAddress ip(data->action_ip[index]);
+
+	WiFiClient *client = &_http_clients[index];
+	client->setTimeout(timeout_ms);
+	client->setNoDelay(true); // request goes out in one segment anyway
+	if (!client->connect(ip, port)) return false;
+
+	char buf[300];
+	int len = action_http_request(buf, sizeof(buf), host, path, action->value);
+	if (len<0) return false;
+	return (client->write((const uint8_t *)buf, len) == (size_t)len);
+}
+
+
+/* Runs all actions, returns number of actions that worked; the MQTT
+ * ones only with_mqtt, when the broker is connected. An HTTP action that
+ * can't be sent schedules a link refresh, which looks its host up again.
+ */
+int actions_run(WIFI_SETTINGS_T *data, uint32_t timeout_ms, bool with_mqtt) {
+	DEBUG_LOG("actions_run()");
+	uint32_t timeout = millis() + timeout_ms; // includes connecting & MQTT
+	int ok = 0;
+	int pending = 0;
+
+	// 1. get all HTTP requests on their way, each connect with the time left
+	for (int i=0; i<MAX_ACTIONS; i++) {
+		_action_ms[i] = -1;
+		_http_pending[i] = false;
+		if (data->actions[i].type != ACTION_HTTP) continue;
+		uint32_t left = ((int32_t)(timeout - millis()) > 0)?(timeout - millis()):0;
+		if (left < HTTP_ACTION_MIN_MS) break;
+		_action_start[i] = millis();
+		_http_pending[i] = _http_start(i, data, left);
+		if (_http_pending[i]) {
+			pending++;
+		} else {
+			DEBUG_LOG("_http_start() FAILED");
+			_http_clients[i].stop();
+			// its address may have changed; look it up again after the press
+			data->link_refresh = 1;
+		}
+	}
+
+	// 2. publish MQTT actions back to back, QoS 0 doesn't wait for the broker
+	for (int i=0; i<MAX_ACTIONS && with_mqtt; i++) {
+		ACTION_T *action = &data->actions[i];
+		if ((action->type != ACTION_MQTT) && (action->type != ACTION_MQTT_RETAIN)) continue;
+		_action_start[i] = millis();
+		if (mqtt_send_topic(action->target, action->value,
+				action->type == ACTION_MQTT_RETAIN)) {
+			_action_ms[i] = millis() - _action_start[i];
+			ok++;
+		}
+	}
+
+	// 3. collect HTTP status lines, in whatever order they arrive
+	while (pending && (millis()<timeout)) {
+		for (int i=0; i<MAX_ACTIONS; i++) {
+			WiFiClient *client = &_http_clients[i];
+			if ((data->actions[i].type != ACTION_HTTP) || !_http_pending[i]) continue;
+			if (client->available()) {
+				// "HTTP/1.1 200 OK" - only the status code matters
+				char status[13];
+				int len = client->readBytes(status, sizeof(status)-1);
+				status[len] = 0;
+				int code = (len>9)?atoi(status+9):0;
+				if (code>=200 && code<300) {
+					_action_ms[i] = millis() - _action_start[i];
+					ok++;
+				}
+			} else if (client->connected()) {
+				continue; // still waiting
+			}
+			client->stop();
+			_http_pending[i] = false;
+			pending--;
+		}
+		delay(1);
+	}
+	for (int i=0; i<MAX_ACTIONS; i++) _http_clients[i].stop();
+	return ok;
+}
+
+
+/* Latency of an action from the last actions_run(), -1 if failed/not run
+ */
+int actions_latency(int index) {
+	if ((index<0) || (index>=MAX_ACTIONS)) return -1;
+	return _action_ms[index];
+}
@@ -0,0 +1,36 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* action_helper.h - extra MQTT & HTTP actions per button press */
+
+#ifndef ACTION_HELPER_H
+#define ACTION_HELPER_H
+
+#include "settings.h"
+#include "action_request.h"
+
+#define HTTP_ACTION_TIMEOUT 3000 // ms, for all HTTP actions together
+#define HTTP_ACTION_MIN_MS 100 // no new connects with less time left
+
+int actions_run(WIFI_SETTINGS_T *data, uint32_t timeout_ms=HTTP_ACTION_TIMEOUT,
+	bool with_mqtt=true);
+int actions_latency(int index);
+
+#endif
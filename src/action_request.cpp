@@ -0,0 +1,90 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* action_request.cpp */
+
+/* Only plain C here, no Arduino, so the native tests in test/ can check
+ * the URL parser & the requests of actions & direct triggers, and the
+ * settings fields can use the action type names.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "settings.h"
+#include "action_request.h"
+
+
+/* Split scheme://host[:port]/path into its parts, e.g. with "http://"
+ * & port 80; returns false if invalid or another scheme.
+ */
+bool action_parse_url(const char *url, const char *scheme, uint16_t default_port,
+		char *host, int host_size, uint16_t *port, const char **path) {
+	int scheme_len = strlen(scheme);
+	if (strncmp(url, scheme, scheme_len)!=0) return false; // e.g. no TLS here
+	const char *start = url + scheme_len;
+	const char *end = start;
+	while (*end && *end!=':' && *end!='/') end++;
+	if ((end==start) || (end-start >= host_size)) return false;
+	memcpy(host, start, end-start);
+	host[end-start] = 0;
+	*port = default_port;
+	if (*end==':') *port = (uint16_t)strtol(end+1, (char **)&end, 10);
+	if (!*port) return false;
+	*path = (*end)?end:"/";
+	return true;
+}
+
+
+/* Build a one-shot HTTP request: POST value as JSON, or GET if it's empty.
+ * Returns the length, or -1 if it doesn't fit.
+ */
+int action_http_request(char *buf, int size, const char *host, const char *path,
+		const char *value) {
+	int len;
+	if (value[0]) {
+		len = snprintf(buf, size, "POST %s HTTP/1.1\r\nHost: %s\r\n"
+			"Content-Type: application/json\r\nContent-Length: %u\r\n"
+			"Connection: close\r\n\r\n%s",
+			path, host, (unsigned)strlen(value), value);
+	} else {
+		len = snprintf(buf, size, "GET %s HTTP/1.1\r\nHost: %s\r\n"
+			"Connection: close\r\n\r\n", path, host);
+	}
+	return (len<size)?len:-1;
+}
+
+
+/* Names used for action types in the settings page */
+static const char * const _action_names[] = { "", "mqtt", "mqtt-retain", "http" };
+
+const char *action_type_name(uint8_t type) {
+	if (type >= sizeof(_action_names)/sizeof(_action_names[0])) return "";
+	return _action_names[type];
+}
+
+uint8_t action_type_from_name(const char *name) {
+	for (uint8_t i=1; i<sizeof(_action_names)/sizeof(_action_names[0]); i++) {
+		if (!strcmp(name, _action_names[i])) return i;
+	}
+	return ACTION_NONE;
+}
@@ -0,0 +1,36 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* action_request.h - types, URLs & HTTP requests of action_helper.cpp */
+
+#ifndef ACTION_REQUEST_H
+#define ACTION_REQUEST_H
+
+#include <stdint.h>
+
+const char *action_type_name(uint8_t type);
+uint8_t action_type_from_name(const char *name);
+
+bool action_parse_url(const char *url, const char *scheme, uint16_t default_port,
+	char *host, int host_size, uint16_t *port, const char **path);
+int action_http_request(char *buf, int size, const char *host, const char *path,
+	const char *value);
+
+#endif
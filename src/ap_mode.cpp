@@ -24,25 +24,91 @@
 #include <ESP8266WiFi.h>
 #include <ESP8266WebServer.h>
 #include <DNSServer.h>
+#include <Updater.h>
+#include <umm_malloc/umm_malloc.h>
+#include <coredecls.h> // esp_delay()
 
 #include "ap_mode.h"
 #include "main.h"
 #include "settings.h"
 #include "wifi_helper.h"
+#include "mqtt_helper.h"
+#include "boot_trace.h"
+#include "text_escape.h"
 
 #define AP_TIMEOUT_SECS 5*60
+#define AP_POLL_MS 1 // checking for HTTP work while phones are connected
+#define AP_DNS_POLL_MS 10 // DNSServer can't tell us about queries, so it's polled
+#define AP_IDLE_CHECK_MS 20 // how often to check for new phones while idle
+#define AP_SCAN_SHOW 10 // networks offered on the setup page
+#define AP_PORTAL_URL "http://192.168.4.1/" // softAP default address
+#define AP_UPDATE_RESUME_SECS 120 // AP stays up this long after an upload, to resume it
 static ESP8266WebServer local_server(80);
 static DNSServer local_dns_server;
 static uint32_t ap_timeout;
 static uint32_t led_time_next;
 static bool led_status;
+static volatile bool _station_joined;
+static WiFiEventHandler _station_handler;
+extern WiFiClient g_wclient; // main.cpp; the MQTT client keeps a pointer to it
 
 
 void _handle_root();
 void _handle_404();
 void _handle_form();
+void _handle_stats();
+static void _handle_probe();
+static void _handle_update_state();
+static void _handle_update_upload();
+static void _handle_update_done();
+static void _handle_trial();
+static void _trial_poll();
 static WIFI_SETTINGS_T *_data; // pointer to actual data
 
+/* URLs phones & computers check to find out if they're behind a captive
+ * portal, with the answer that makes each of them show our page right
+ * away. code 302 redirects to our homepage.
+ */
+struct PROBE_T {
+	const char *path;
+	int code;
+	const char *body; // for 200 only
+};
+static const char _probe_refresh[] = "<!DOCTYPE HTML><html><head>"
+	"<meta http-equiv=\"refresh\" content=\"0; url=" AP_PORTAL_URL "\"></head></html>";
+static const PROBE_T _probes[] = {
+	{ "/generate_204", 302, NULL }, // Android, Chrome; anything but a 204
+	{ "/gen_204", 302, NULL },
+	{ "/hotspot-detect.html", 200, _probe_refresh }, // Apple; anything without "Success"
+	{ "/library/test/success.html", 200, _probe_refresh },
+	{ "/connecttest.txt", 302, NULL }, // Windows 10+, then opens /redirect
+	{ "/redirect", 302, NULL },
+	{ "/ncsi.txt", 302, NULL }, // older Windows
+	{ "/success.txt", 302, NULL }, // Firefox
+	{ "/canonical.html", 302, NULL },
+	{ "/kindle-wifi/wifistub.html", 302, NULL }, // Kindle
+};
+static bool _probe_seen;
+
+/* Firmware upload, see _handle_update_upload() */
+static uint32_t _update_size; // expected image size; 0 = unknown, can't resume
+static uint32_t _update_start; // ms, start of this request
+static uint32_t _update_from; // image offset this request started at
+static uint32_t _update_received; // image bytes handed to Update, incl. the ones it still buffers
+static uint32_t _update_bytes; // received in this request
+static bool _update_started; // this request had an image
+static bool _update_done; // complete & verified, reboot into it
+static const char *_update_error;
+
+/* "Test and save", run from the loop in run_ap_mode(), see _trial_poll() */
+#define TRIAL_IDLE 0
+#define TRIAL_CONNECTING 1
+#define TRIAL_DONE 2
+static uint8_t _trial_state = TRIAL_IDLE;
+static uint32_t _trial_start;
+static uint32_t _trial_wifi_ms, _trial_lookup_ms, _trial_mqtt_ms;
+static bool _trial_wifi_ok, _trial_mqtt_ok;
+
 /* Enables AP mode, if doable
  */
 bool enable_ap_mode(WIFI_SETTINGS_T *data) {
@@ -53,17 +119,22 @@ bool enable_ap_mode(WIFI_SETTINGS_T *data) {
 	(void)WiFi.macAddress(&mac[0]);
 	snprintf(ap_name, sizeof(ap_name), "AP_%02X%02X%02X", mac[3], mac[4], mac[5]);
 
-	bool res = WiFi.softAP(ap_name, ""); // no password
+	// on the channel of our network, if known: a trial connect next to the
+	// AP then doesn't move the AP, which would drop the phone
+	uint8_t channel = data->hint_channel?data->hint_channel:data->wifi_channel;
+	bool res = WiFi.softAP(ap_name, "", channel?channel:1); // no password
 	if (res) {
-		DEBUG_LOG("AP mode enabled.");
-		#ifdef DEBUG_MODE
-		Serial.print("AP: "); Serial.println(ap_name);
-		#endif
+		// the name is AP_ and these last 3 bytes of the MAC, in hex
+		DEBUG_LOG1("AP mode enabled, MAC end", (mac[3] << 16) | (mac[4] << 8) | mac[5]);
+		DEBUG_LOG1("AP mode enabled, channel", channel?channel:1);
 
 		// set up DNS for captive portal
 		DEBUG_LOG("Starting DNS");
 		local_dns_server.setErrorReplyCode(DNSReplyCode::NoError);
 		local_dns_server.start(53, "*", WiFi.softAPIP()); // always send our IP
+
+		// look for networks meanwhile; the results stay with the SDK
+		WiFi.scanNetworks(true);
 	}
 	return res;
 }
@@ -75,10 +146,43 @@ static void _handle_led() {
 		led_time_next = millis() + (led_status?500:1500);
 		led_status = !led_status;
 		digitalWrite(LED_PIN, led_status?LOW:HIGH);
-		#ifdef DEBUG_MODE
-		if (led_status) Serial.print(".");
-		#endif
+		if (led_status) {
+			DEBUG_LOG1("AP mode, s left", (int32_t)(ap_timeout - millis()) / 1000);
+		}
+	}
+}
+
+/* Whether the web server has something to do: a new connection, or data
+ * on a new or the current one.
+ */
+static bool _http_pending() {
+	return local_server.getServer().hasClient() || local_server.getServer().hasClientData()
+		|| local_server.client().available();
+}
+
+
+/* Wait until there may be work: the next LED change or the timeout, or
+ * a phone joining the AP. While no phone is connected nobody can send us
+ * DNS or HTTP requests, so the servers aren't polled at all; with a phone
+ * connected, we wake up as soon as there's an HTTP connection or data,
+ * and at least every AP_DNS_POLL_MS for DNS.
+ * The soft AP needs the radio on, so modem / light sleep aren't possible;
+ * esp_delay() lets the CPU idle in between.
+ */
+static void _wait_for_work() {
+	uint32_t now = millis();
+	uint32_t next = (led_time_next < ap_timeout)?led_time_next:ap_timeout;
+	uint32_t wait = (next > now)?(next - now):0;
+	if (WiFi.softAPgetStationNum() || (_trial_state == TRIAL_CONNECTING)) {
+		if (wait > AP_DNS_POLL_MS) wait = AP_DNS_POLL_MS;
+		esp_delay(wait, []() { return !_http_pending(); }, AP_POLL_MS);
+		return;
 	}
+	#ifdef DEBUG_SERIAL_LATER
+	log_ring_drain(); // nobody's connected, we have time
+	#endif
+	_station_joined = false;
+	esp_delay(wait, []() { return !_station_joined; }, AP_IDLE_CHECK_MS);
 }
 
 /* Runs device in AP mode to do settings and stuff
@@ -90,16 +194,28 @@ void run_ap_mode(WIFI_SETTINGS_T *data) {
 	led_status = false;
 	led_time_next = millis();
 	_data = data;
+	trace_sample(TRACE_AP_START);
 
 	local_server.on("/", _handle_root);
 	local_server.on("/get", _handle_form);
+	local_server.on("/trial", _handle_trial);
+	local_server.on("/stats", _handle_stats);
+	local_server.on("/update", HTTP_GET, _handle_update_state);
+	local_server.on("/update", HTTP_POST, _handle_update_done, _handle_update_upload);
+	for (unsigned int i=0; i<sizeof(_probes)/sizeof(_probes[0]); i++) {
+		local_server.on(_probes[i].path, _handle_probe);
+	}
 	local_server.onNotFound(_handle_404);
+	local_server.keepAlive(true); // probes come in bursts
 	local_server.begin();
+	_station_handler = WiFi.onSoftAPModeStationConnected(
+		[](const WiFiEventSoftAPModeStationConnected &) { _station_joined = true; });
 	while (millis() < ap_timeout) {
 		_handle_led();
 		local_server.handleClient();
 		local_dns_server.processNextRequest();
-		delay(10);
+		_trial_poll();
+		_wait_for_work();
 	}
 	DEBUG_LOG("Rebooting after timeout.");
 	delay(500);
@@ -115,36 +231,21 @@ bool _check_captive_portal() {
 		DEBUG_LOG("_check_captive_portal(): Redirecting");
 		local_server.sendHeader("Location", 
 			String("http://") + local_server.client().localIP().toString(), true);
-		local_server.send(302, "text/plain", "");   
-		local_server.client().stop(); 
+		local_server.send(302, "text/plain", ""); // with length, can stay open
 		return true;
 	}
 	return false;
 }
 
 
-/* show string in HTML escaped form; ignore entities, escape all non-alphanum
+/* show string in HTML escaped form, see escape_html()
  */
 void _show_escape_html(char *input) {
 	char buf[100];
-	char *in_ptr = input;
-	char *out_ptr = (char *)&buf;
-	while (*in_ptr) {
-		if (isalnum(*in_ptr)) {
-			*out_ptr=*in_ptr; out_ptr++;
-		} else {
-			out_ptr += sprintf(out_ptr, "&#%i;", *in_ptr);
-		}
-
-		if (out_ptr-(char *)&buf>(int)sizeof(buf)-8) {
-			*out_ptr=0;
-			local_server.sendContent(buf);
-			out_ptr=(char *)&buf;
-		}
-		in_ptr++;
-	}
-	*out_ptr=0;
-	local_server.sendContent(buf);
+	do {
+		input += escape_html(buf, sizeof(buf), input);
+		local_server.sendContent(buf);
+	} while (*input);
 }
 
 /* Show one of the fields as a form input
@@ -160,11 +261,71 @@ void _show_field(char const *label, char const *id, char *value) {
 	local_server.sendContent("\"></p>\n");
 }
 
+/* Show a secret field as an empty password input; if it's set, changing
+ * it needs the current value too, see _secret_change_ok().
+ */
+static void _show_secret_field(const SETTINGS_FIELD_T *field) {
+	local_server.sendContent("<p>");
+	local_server.sendContent(field->label);
+	local_server.sendContent(":<br><input type=\"password\" name=\"");
+	local_server.sendContent(field->name);
+	local_server.sendContent("\" placeholder=\"unchanged\">");
+	if (*((char *)_data + field->offset)) {
+		local_server.sendContent("<br>Current one, to change it:<br><input type=\"password\" name=\"");
+		local_server.sendContent(field->name);
+		local_server.sendContent("_old\">");
+	}
+	local_server.sendContent("</p>\n");
+}
+
+/* Offer the networks found by the scan, strongest first, once per SSID
+ */
+static void _show_networks() {
+	int found = WiFi.scanComplete();
+	if (found == WIFI_SCAN_RUNNING) {
+		local_server.sendContent("<p>Looking for networks ... <a href=\"/\">reload</a></p>\n");
+		return;
+	}
+	local_server.sendContent("<p>Or pick a network (<a href=\"/?scan=1\">scan again</a>):<br>\n"
+		"<label><input type=\"radio\" name=\"wifi_pick\" value=\"\" checked> as typed above</label><br>\n");
+	if (found > 32) found = 32;
+	uint32_t used = 0; // bit per scan result
+	char buf[40];
+	for (int n=0; n<AP_SCAN_SHOW; n++) {
+		int best = -1;
+		for (int i=0; i<found; i++) {
+			if ((used & (1UL<<i)) || !WiFi.SSID(i).length()) continue;
+			if ((best < 0) || (WiFi.RSSI(i) > WiFi.RSSI(best))) best = i;
+		}
+		if (best < 0) break;
+		for (int i=0; i<found; i++) {
+			if (WiFi.SSID(i) == WiFi.SSID(best)) used |= 1UL<<i; // weaker BSSIDs
+		}
+		// value: "bssid,channel,ssid", see _apply_pick()
+		String ssid = WiFi.SSID(best);
+		local_server.sendContent("<label><input type=\"radio\" name=\"wifi_pick\" value=\"");
+		snprintf(buf, sizeof(buf), "%s,%i,", WiFi.BSSIDstr(best).c_str(), (int)WiFi.channel(best));
+		_show_escape_html(buf);
+		_show_escape_html((char *)ssid.c_str());
+		local_server.sendContent("\"> ");
+		_show_escape_html((char *)ssid.c_str());
+		snprintf(buf, sizeof(buf), " (channel %i, %i dBm)</label><br>\n",
+			(int)WiFi.channel(best), (int)WiFi.RSSI(best));
+		local_server.sendContent(buf);
+	}
+	local_server.sendContent("</p>\n");
+}
+
+
 /* Serve homepage, with form for settings
  */
 void _handle_root() {
 	DEBUG_LOG("_handle_root()");
+	trace_sample(TRACE_AP_ROOT);
 	if (_check_captive_portal()) return; // we're redirecting
+	if (local_server.hasArg("scan") && (WiFi.scanComplete() != WIFI_SCAN_RUNNING)) {
+		WiFi.scanNetworks(true);
+	}
 
 	// header
 	local_server.sendContent("HTTP/1.1 200 OK\r\n"
@@ -182,31 +343,47 @@ void _handle_root() {
 		</head><body><h1>Fast button setup</h1>
 		<form action="/get">)rawliteral" );
 
-	char buf[20];
-
-	_show_field("Wifi SSID", "wifi_ssid", _data->wifi_ssid);
-	_show_field("Wifi Password", "wifi_auth", _data->wifi_auth);
-
-	_show_field("MQTT Host (or empty)", "mqtt_host_str", _data->mqtt_host_str);
-	snprintf(buf, sizeof(buf), "%i", _data->mqtt_host_port);
-	_show_field("MQTT Port", "mqtt_host_port", buf);
-	_show_field("MQTT Username", "mqtt_user", _data->mqtt_user);
-	_show_field("MQTT Password", "mqtt_auth", _data->mqtt_auth);
-
-	_show_field("MQTT Client ID", "mqtt_client_id", _data->mqtt_client_id);
-	_show_field("MQTT Topic", "mqtt_topic", _data->mqtt_topic);
-	_show_field("MQTT Topic value", "mqtt_value", _data->mqtt_value);
-	_show_field("MQTT Home Assistant Topic", "mqtt_ha", _data->mqtt_homeassistant_topic);
-
-	_show_field("REST URL (or empty)", "rest_url", _data->rest_url);
+	#ifdef BAKED_CONFIG
+	local_server.sendContent("<p>Settings are baked into this image and can't be changed here.</p>");
+	#endif
+
+	// all editable settings, see g_settings_fields
+	char buf[120];
+	for (int i=0; i<g_settings_field_count; i++) {
+		const SETTINGS_FIELD_T *field = &g_settings_fields[i];
+		if ((field->type & FIELD_TYPE_MASK) == FIELD_SECTION) {
+			local_server.sendContent("<h2>");
+			local_server.sendContent(field->label);
+			local_server.sendContent("</h2>");
+			continue;
+		}
+		if (field->type & FIELD_SECRET) {
+			_show_secret_field(field);
+			continue;
+		}
+		settings_field_get(field, _data, buf, sizeof(buf));
+		_show_field(field->label, field->name, buf);
+		if (field->type & FIELD_NEW_NETWORK) _show_networks();
+	}
 
 	// below form
 	local_server.sendContent( R"rawliteral(
 		<input type="submit" name="submit" value="Save settings">)rawliteral" );
 	local_server.sendContent( R"rawliteral(
 		<input type="submit" name="reboot" value="Save and reboot">)rawliteral" );
+	local_server.sendContent( R"rawliteral(
+		<input type="submit" name="test" value="Test and save">)rawliteral" );
 	local_server.sendContent("</form>");
 
+	// firmware update; use tools/ota_push.py to resume & verify
+	local_server.sendContent( R"rawliteral(
+		<h2>Firmware update</h2>
+		<form method="POST" action="/update" enctype="multipart/form-data"
+		onsubmit="this.action='/update?password='+encodeURIComponent(this.password.value)">
+		<p><input type="file" name="image" accept=".bin,.gz"><br>
+		Firmware update password:<br><input type="password" name="password">
+		<input type="submit" value="Update"></p></form>)rawliteral" );
+
 	// page footer start
 	local_server.sendContent( R"rawliteral(
 		<footer>
@@ -245,51 +422,213 @@ void _handle_root() {
 }
 
 
-/* Check if the user submitted the variable, then read it
- * Check for maximal length, store everything. Return 1 if changed.
+/* Use a network picked from the scan, "bssid,channel,ssid"; its BSSID &
+ * channel let the first slow connect skip the scan. Returns 1 if changed.
  */
-int _read_field(char const *id, char *dest, int len) {
-	if (local_server.hasArg(id)) {
-		if (local_server.arg(id).length()<(unsigned int)len-1) {
-			int changed = (strcmp(dest, local_server.arg(id).c_str())!=0)?1:0;
-			strcpy(dest, local_server.arg(id).c_str());
-			return changed;
+static int _apply_pick(const char *pick) {
+	uint8_t bssid[6];
+	int channel, pos = 0;
+	if (sscanf(pick, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx,%i,%n", &bssid[0], &bssid[1], &bssid[2],
+			&bssid[3], &bssid[4], &bssid[5], &channel, &pos) < 7 || !pos) return 0;
+	if ((channel < 1) || (channel > 14)) return 0;
+	int changed = settings_field_set(settings_field_find("wifi_ssid"), _data, pick+pos);
+	if (changed < 0) return 0;
+	memcpy(_data->hint_bssid, bssid, sizeof(bssid));
+	_data->hint_channel = channel;
+	return 1;
+}
+
+
+/* Show one step of the trial connect */
+static void _show_trial_step(const char *label, uint32_t ms, bool ok) {
+	char buf[120];
+	snprintf(buf, sizeof(buf), "<tr><td>%s</td><td>%lu ms</td><td>%s</td></tr>\n",
+		label, (unsigned long)ms, ok?"OK":"FAILED");
+	local_server.sendContent(buf);
+}
+
+
+/* Start trying the settings like a slow connect in setup() would, next
+ * to the running AP; _trial_poll() carries on from the loop, so DNS & HTTP
+ * are still served meanwhile.
+ */
+static void _trial_begin() {
+	DEBUG_LOG("_trial_begin()");
+	_trial_start = millis();
+	_trial_wifi_ms = _trial_lookup_ms = _trial_mqtt_ms = 0;
+	_trial_wifi_ok = _trial_mqtt_ok = false;
+	// the AP follows the network's channel, if it isn't on it already
+	WiFi.mode(WIFI_AP_STA);
+	WiFi.config(0U, 0U, 0U);
+	WiFi.begin(_data->wifi_ssid, _data->wifi_auth, _data->hint_channel,
+		_data->hint_channel?_data->hint_bssid:NULL);
+	_trial_state = TRIAL_CONNECTING;
+}
+
+
+/* Finish the trial once wifi is connected or timed out, and save the
+ * result: with a warmed cache, the first press after setup can use the
+ * fast connect. Call it from the loop; returns quickly while connecting.
+ */
+static void _trial_poll() {
+	if (_trial_state != TRIAL_CONNECTING) return;
+	_trial_wifi_ok = (WiFi.status() == WL_CONNECTED);
+	if (!_trial_wifi_ok && (millis() - _trial_start < SLOW_TIMEOUT)) return;
+	_trial_wifi_ms = millis() - _trial_start;
+	DEBUG_LOG1("_trial_poll() connect done, ms", _trial_wifi_ms);
+
+	if (_trial_wifi_ok) {
+		// BSSID, channel, IPs & MQTT server, like after a slow connect
+		uint32_t start = millis();
+		build_settings_from_wifi(_data, &WiFi);
+		_data->hint_channel = 0; // the cache is better
+		_trial_lookup_ms = millis() - start;
+		if (_data->mqtt_host_ip) {
+			// a connection from before AP mode would pass without trying
+			// the broker just entered; g_wclient outlives this function
+			mqtt_disconnect();
+			start = millis();
+			_trial_mqtt_ok = mqtt_connect_server(&g_wclient, _data, PRECONNECT_TIMEOUT);
+			_trial_mqtt_ms = millis() - start;
+			mqtt_disconnect();
 		}
+	} else {
+		_data->wifi_channel = 0; // forces traditional wifi connect next
 	}
-	return 0;
+	save_settings_to_flash(_data);
+	trace_sample(TRACE_AP_TRIAL, _trial_wifi_ok?(_trial_mqtt_ok?2:1):0);
+	WiFi.disconnect();
+	WiFi.mode(WIFI_AP);
+	_trial_state = TRIAL_DONE;
 }
 
 
+/* Trial status page: reloads itself while testing, then shows the time
+ * of each step.
+ */
+static void _handle_trial() {
+	DEBUG_LOG("_handle_trial()");
+	bool running = (_trial_state == TRIAL_CONNECTING);
+	local_server.sendContent("HTTP/1.1 200 OK\r\n"
+		"Content-Type: text/html\r\n"
+		"Pragma: no-cache\r\n\r\n");
+	local_server.sendContent(
+		R"rawliteral(<!DOCTYPE HTML><html><head><meta charset="utf-8" />
+		<meta name="viewport" content="width=device-width, initial-scale=1" />)rawliteral" );
+	if (running) {
+		local_server.sendContent( R"rawliteral(<meta http-equiv="refresh" content="1">
+			<title>Testing</title></head><body><h1>Testing ...</h1>
+			<p>This takes a few seconds. If the phone leaves the setup network,
+			join it again; this page then shows the results.</p>
+			</body></html>)rawliteral" );
+		local_server.client().stop();
+		return;
+	}
+	local_server.sendContent( R"rawliteral(<title>Test results</title>
+		</head><body><h1>Test results</h1>)rawliteral" );
+	if (_trial_state == TRIAL_DONE) {
+		local_server.sendContent("<table>");
+		_show_trial_step("Wifi connect", _trial_wifi_ms, _trial_wifi_ok);
+		if (_trial_wifi_ok) _show_trial_step("Addresses &amp; MQTT host lookup", _trial_lookup_ms,
+			!FEATURE_MQTT || _data->mqtt_host_ip || !_data->mqtt_host_str[0]);
+		if (_data->mqtt_host_ip) _show_trial_step("MQTT connect", _trial_mqtt_ms, _trial_mqtt_ok);
+		local_server.sendContent("</table><p>");
+		local_server.sendContent(_trial_wifi_ok?"Saved, the next press can use the fast connect."
+			:"Saved, but the wifi settings didn't work.");
+		local_server.sendContent("</p>");
+	} else {
+		local_server.sendContent("<p>No test has run yet.</p>");
+	}
+	local_server.sendContent( R"rawliteral(
+		<p><a href="/">Back to settings</a></p>
+		<form action="/get"><input type="submit" name="reboot" value="Reboot"></form>
+		</body></html>)rawliteral" );
+	local_server.client().stop();
+}
+
+
+/* Whether a secret field may be changed on the setup page: something was
+ * entered, and the current value too, if there is one. So whoever joins
+ * the open AP can't take over e.g. the firmware update password.
+ */
+static bool _secret_change_ok(const SETTINGS_FIELD_T *field) {
+	const char *current = (const char *)_data + field->offset;
+	if (!local_server.arg(field->name).length()) return false;
+	if (!*current) return true;
+	char old_name[40];
+	snprintf(old_name, sizeof(old_name), "%s_old", field->name);
+	return local_server.arg(old_name) == current;
+}
+
+
+#ifdef BAKED_CONFIG
+/* Baked builds: whether the form tries to change a setting, which would
+ * only last until the next boot, see _use_baked_settings() in settings.cpp
+ */
+static bool _form_changes_baked() {
+	char buf[120];
+	for (int i=0; i<g_settings_field_count; i++) {
+		const SETTINGS_FIELD_T *field = &g_settings_fields[i];
+		if (!field->name || !local_server.hasArg(field->name)) continue;
+		if (field->type & FIELD_SECRET) {
+			if (local_server.arg(field->name).length()) return true;
+			continue;
+		}
+		settings_field_get(field, _data, buf, sizeof(buf));
+		if (local_server.arg(field->name) != buf) return true;
+	}
+	return local_server.hasArg("wifi_pick") && local_server.arg("wifi_pick").length();
+}
+#endif
+
+
 /* Handle submitted form, extract variables & save
  */
 void _handle_form() {
+	DEBUG_LOG("_handle_form()");
+	trace_sample(TRACE_AP_FORM);
+
+	#ifdef BAKED_CONFIG
+	if (_form_changes_baked()) {
+		DEBUG_LOG("Baked settings, changes rejected.");
+		local_server.send(403, "text/html", "Settings are baked into this image, "
+			"rebuild it with tools/bake_config.py to change them. <a href=\"/\">Back</a>");
+		return;
+	}
+	#endif
 
 	// handle fields
 	int changes = 0;
-	changes += _read_field("wifi_ssid", _data->wifi_ssid, sizeof(_data->wifi_ssid));
-	changes += _read_field("wifi_auth", _data->wifi_auth, sizeof(_data->wifi_auth));
-
-	changes += _read_field("mqtt_host_str", _data->mqtt_host_str, sizeof(_data->mqtt_host_str));
-	char buf[20], *end;
-	snprintf(buf, sizeof(buf), "%i", _data->mqtt_host_port);
-	changes += _read_field("mqtt_port", (char *)&buf, sizeof(buf));
-	long int res = strtol(buf, &end, 10);
-	if (res>0 && res<32000) _data->mqtt_host_port= (int)res;
-
-	changes += _read_field("mqtt_user", _data->mqtt_user, sizeof(_data->mqtt_user));
-	changes += _read_field("mqtt_auth", _data->mqtt_auth, sizeof(_data->mqtt_auth));
-
-	changes += _read_field("mqtt_client_id", _data->mqtt_client_id, sizeof(_data->mqtt_client_id));
-	changes += _read_field("mqtt_topic", _data->mqtt_topic, sizeof(_data->mqtt_topic));
-	changes += _read_field("mqtt_value", _data->mqtt_value, sizeof(_data->mqtt_value));
-	changes += _read_field("mqtt_ha", _data->mqtt_homeassistant_topic, sizeof(_data->mqtt_homeassistant_topic));
+	bool reconnect = false; // like config_apply()
+	for (int i=0; i<g_settings_field_count; i++) {
+		const SETTINGS_FIELD_T *field = &g_settings_fields[i];
+		if (!field->name || !local_server.hasArg(field->name)) continue;
+		if ((field->type & FIELD_SECRET) && !_secret_change_ok(field)) continue;
+		if (settings_field_set(field, _data, local_server.arg(field->name).c_str()) > 0) {
+			changes++;
+			if (field->type & FIELD_RECONNECT) reconnect = true;
+		}
+	}
+	if (local_server.hasArg("wifi_pick") && local_server.arg("wifi_pick").length()) {
+		int picked = _apply_pick(local_server.arg("wifi_pick").c_str());
+		changes += picked;
+		if (picked) reconnect = true; // a network, so wifi_ssid
+	}
 
-	changes += _read_field("rest_url", _data->rest_url, sizeof(_data->rest_url));
+	if (local_server.hasArg("test")) {
+		if (changes) compile_settings_templates(_data);
+		if (_trial_state != TRIAL_CONNECTING) _trial_begin(); // saves when done
+		local_server.sendContent("HTTP/1.1 303 See other\r\n"
+			"Location: /trial\r\n\r\n");
+		local_server.client().stop();
+		return;
+	}
 
 	if (changes) {
 		// save to flash
 		DEBUG_LOG("Found changes, saving to flash.");
-		_data->wifi_channel = 0; // forces traditional wifi connect next
+		compile_settings_templates(_data);
+		if (reconnect) _data->wifi_channel = 0; // forces traditional wifi connect next
 		save_settings_to_flash(_data);
 	}
 
@@ -322,7 +661,165 @@ void _handle_form() {
 /* Handle the 404 page
  */
 void _handle_404() {
+	trace_sample(TRACE_AP_404);
 	if (_check_captive_portal()) return; // we're redirecting
 	local_server.send(404, "text/html", "404 Not found");
-	local_server.client().stop(); 
+}
+
+
+/* Answer a captive portal check, see _probes
+ */
+static void _handle_probe() {
+	unsigned int i = 0;
+	while ((i < sizeof(_probes)/sizeof(_probes[0])-1)
+		&& (local_server.uri() != _probes[i].path)) i++;
+	if (!_probe_seen) {
+		// time from AP start to the first check, see /stats
+		trace_sample(TRACE_AP_PROBE, i);
+		_probe_seen = true;
+	}
+	if (_probes[i].code == 302) {
+		local_server.sendHeader("Location", AP_PORTAL_URL, true);
+		local_server.send(302, "text/plain", "");
+	} else {
+		local_server.send(_probes[i].code, "text/html", _probes[i].body);
+	}
+}
+
+
+/* Show how much of a resumable firmware upload arrived so far, as
+ * "offset=<bytes> size=<bytes>"; both are 0 if none is running. The
+ * offset counts all bytes Update took, not only the ones it already
+ * wrote to flash (Update.progress()), which lags by up to a sector.
+ */
+static void _handle_update_state() {
+	char buf[50];
+	snprintf(buf, sizeof(buf), "offset=%lu size=%lu\n",
+		(unsigned long)(Update.isRunning()?_update_received:0),
+		(unsigned long)(Update.isRunning()?_update_size:0));
+	local_server.send(200, "text/plain", buf);
+}
+
+
+/* Stream an uploaded firmware image into flash. It can be gzip compressed,
+ * the boot loader unpacks it. Needs password=<update_auth>, so nobody
+ * else on the open AP can flash it; without one set, there are no updates.
+ * Optional arguments:
+ *   size=<bytes>: the image may arrive in several uploads, each continuing
+ *     at offset=<bytes>, e.g. after a dropped connection
+ *   md5=<hex>: only install the image if it matches
+ * Without size, the image must arrive in one upload.
+ */
+static void _handle_update_upload() {
+	HTTPUpload &upload = local_server.upload();
+	if (upload.status == UPLOAD_FILE_START) {
+		DEBUG_LOG("_handle_update_upload(): start");
+		_update_started = true;
+		_update_error = NULL;
+		_update_bytes = 0;
+		_update_start = millis();
+		uint32_t offset = local_server.arg("offset").toInt();
+		if (!_data->update_auth[0]) {
+			_update_error = "no update password set, see the setup page";
+		} else if (local_server.arg("password") != _data->update_auth) {
+			_update_error = "wrong update password";
+		} else if (offset == 0) {
+			if (Update.isRunning()) Update.end(false); // start over
+			_update_size = local_server.arg("size").toInt();
+			_update_received = 0;
+			uint32_t space = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+			if (!Update.begin(_update_size?_update_size:space)) {
+				_update_error = "can't start, image too big?";
+			} else if (local_server.hasArg("md5")
+					&& !Update.setMD5(local_server.arg("md5").c_str())) {
+				_update_error = "invalid md5";
+				Update.end(false);
+			}
+		} else if (!Update.isRunning() || (offset != _update_received)) {
+			_update_error = "offset doesn't match, see GET /update";
+		}
+		_update_from = Update.isRunning()?_update_received:0;
+		// time to resume it, if the connection drops
+		if (ap_timeout < millis() + AP_UPDATE_RESUME_SECS * 1000L) {
+			ap_timeout = millis() + AP_UPDATE_RESUME_SECS * 1000L;
+		}
+	} else if (upload.status == UPLOAD_FILE_WRITE) {
+		if (_update_error) return;
+		if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
+			_update_error = "flash write failed";
+			Update.end(false);
+			return;
+		}
+		_update_received += upload.currentSize;
+	} else if (upload.status == UPLOAD_FILE_END) {
+		if (_update_error) return;
+		_update_bytes = _update_received - _update_from;
+		if (_update_size && (_update_received < _update_size)) return; // more to come
+		// checks size, image header & md5
+		_update_done = Update.end(true);
+		if (!_update_done) _update_error = "image check failed";
+	} else if (upload.status == UPLOAD_FILE_ABORTED) {
+		DEBUG_LOG("_handle_update_upload(): aborted");
+		// keep what arrived, if it can be resumed
+		if (Update.isRunning()) _update_bytes = _update_received - _update_from;
+		if (!_update_size) Update.end(false);
+	}
+}
+
+
+/* Answer a firmware upload, as "<state> offset=<bytes> size=<bytes>
+ * bytes=<this upload> ms=<this upload> rate=<bytes/s>", state being
+ * done, partial or error. Reboots into the new firmware when done.
+ */
+static void _handle_update_done() {
+	DEBUG_LOG("_handle_update_done()");
+	uint32_t ms = millis() - _update_start;
+	uint32_t rate = ms?(uint64_t)_update_bytes * 1000 / ms:0;
+	trace_sample(TRACE_AP_UPDATE, rate);
+
+	const char *state = _update_done?"done":"partial";
+	if (!_update_started) _update_error = "no image";
+	if (_update_error) state = "error";
+	uint32_t offset = (_update_done || Update.isRunning())?_update_received:0;
+	char buf[150];
+	int len = snprintf(buf, sizeof(buf), "%s offset=%lu size=%lu bytes=%lu ms=%lu rate=%lu\n",
+		state, (unsigned long)offset, (unsigned long)_update_size,
+		(unsigned long)_update_bytes, (unsigned long)ms, (unsigned long)rate);
+	if (_update_error && (len < (int)sizeof(buf))) {
+		snprintf(buf + len, sizeof(buf) - len, "%s: %s\n", _update_error,
+			Update.hasError()?Update.getErrorString().c_str():"");
+	}
+	local_server.send(_update_error?400:200, "text/plain", buf);
+	_update_started = false;
+
+	if (_update_done) {
+		DEBUG_LOG("Rebooting into the new firmware.");
+		local_server.client().stop();
+		delay(500);
+		ESP.restart(); ESP.reset();
+	}
+}
+
+
+/* Show heap & timing samples as plain text; "min" is the lowest free
+ * heap since boot, or since the last /stats?reset.
+ */
+void _handle_stats() {
+	DEBUG_LOG("_handle_stats()");
+	trace_sample(TRACE_AP_STATS);
+
+	char buf[100];
+	local_server.sendContent("HTTP/1.1 200 OK\r\n"
+		"Content-Type: text/plain\r\n"
+		"Pragma: no-cache\r\n\r\n");
+	snprintf(buf, sizeof(buf), "now %lu ms  heap %u  min %u  block %u  frag %u%%  stack %u\n\n",
+		millis(), ESP.getFreeHeap(), (unsigned)umm_free_heap_size_min(), ESP.getMaxFreeBlockSize(),
+		ESP.getHeapFragmentation(), ESP.getFreeContStack());
+	local_server.sendContent(buf);
+	if (local_server.hasArg("reset")) umm_free_heap_size_min_reset();
+	for (int i=0; i<trace_count(); i++) {
+		trace_format(buf, sizeof(buf), trace_get(i));
+		local_server.sendContent(buf);
+	}
+	local_server.client().stop();
 }
@@ -0,0 +1,97 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* benchmark.cpp */
+
+/* Times what only the device itself can show, flash access & heap use,
+ * and prints one CSV line per benchmark to Serial:
+ *   bench,<name>,<iterations>,<ns per op>,<peak heap bytes>
+ * where peak heap bytes is the most heap in use at once during all the
+ * iterations, measured from the free heap's low-water mark.
+ * The pure helpers (templates, escaping, settings fields) are timed on
+ * the host instead, see test/test_bench. Capture two runs and compare
+ * them with tools/bench_compare.py.
+ * Enable with DEBUG_BENCHMARK in main.h; the device then only benchmarks.
+ */
+
+#include <Arduino.h>
+#include <umm_malloc/umm_malloc.h>
+
+#include "main.h"
+#include "settings.h"
+#include "mqtt_helper.h"
+
+static WIFI_SETTINGS_T _bench_settings;
+#ifdef BENCH_FLASH_WRITES
+static WIFI_SETTINGS_T _bench_saved; // what's stored, saved unchanged
+#endif
+
+
+/* Run fn() iterations times, print timing & heap use
+ */
+template <typename T>
+static void _bench(const char *name, int iterations, T fn) {
+	yield(); // keep the watchdog happy between benchmarks
+	uint32_t heap_before = ESP.getFreeHeap();
+	umm_free_heap_size_min_reset();
+	uint32_t start = ESP.getCycleCount();
+	for (int i=0; i<iterations; i++) fn();
+	uint32_t cycles = ESP.getCycleCount() - start;
+	uint32_t peak = heap_before - umm_free_heap_size_min();
+
+	char buf[100];
+	snprintf(buf, sizeof(buf), "bench,%s,%i,%lu,%lu", name, iterations,
+		(unsigned long)((uint64_t)cycles * 1000 / ESP.getCpuFreqMHz() / iterations),
+		(unsigned long)peak);
+	Serial.println(buf);
+}
+
+
+/* Run all benchmarks
+ */
+void run_benchmarks() {
+	Serial.println(F("bench,name,iterations,ns_per_op,peak_heap_bytes"));
+
+	// the slot is looked up once per boot, then it's one 2 KB flash read;
+	// settings are read with spi_flash_read(), not the EEPROM library
+	_bench("get_settings_from_flash", 20, []() {
+		get_settings_from_flash(&_bench_settings);
+	});
+	#ifdef BENCH_FLASH_WRITES
+	// it saves a copy of the stored settings, so they survive unchanged;
+	// two saves, one per slot. Without stored settings, it's skipped.
+	if (get_settings_from_flash(&_bench_saved)) {
+		_bench("save_settings_to_flash", 2, []() {
+			save_settings_to_flash(&_bench_saved);
+		});
+	}
+	#endif
+
+	#if FEATURE_MQTT
+	// not connected: builds the payload on the stack & heap, then
+	// mqtt_send_topic() returns false
+	default_settings(&_bench_settings);
+	strcpy(_bench_settings.mqtt_homeassistant_topic, "homeassistant");
+	_bench("mqtt_send_autodiscover", 200, []() {
+		mqtt_send_autodiscover(&_bench_settings);
+	});
+	#endif
+	Serial.println(F("bench,done"));
+}
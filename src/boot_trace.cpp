@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* boot_trace.cpp */
+
+/* Keeps the last TRACE_SIZE samples in a RAM ring. Sampling is cheap
+ * (no allocations, no output), so it can be used on the hot path;
+ * the samples are shown at the end of setup() and on /stats in AP mode.
+ */
+
+#include <Arduino.h>
+
+#include "main.h"
+#include "boot_trace.h"
+
+#define TRACE_SIZE 32
+
+static TRACE_ENTRY_T _trace[TRACE_SIZE];
+static int _trace_next; // next write position
+static int _trace_count;
+
+static const char * const _trace_names[TRACE_EVENT_COUNT] = {
+	"setup_start", "settings_read", "wifi_connected", "mqtt_connected",
+	"mqtt_published", "actions_done", "rest_done", "setup_done",
+	"ap_start", "ap_root", "ap_form", "ap_404", "ap_stats",
+	"plan_wifi_fast", "plan_wifi_slow", "plan_direct", "plan_mqtt", "plan_actions", "plan_rest",
+	"strategy", "rf_cal", "ap_trial", "ap_probe",
+	"ap_update", "direct_done"
+};
+
+
+/* Record time, heap & stack for an event
+ */
+void trace_sample(uint8_t event, uint32_t value) {
+	TRACE_ENTRY_T *entry = &_trace[_trace_next];
+	entry->ms = millis();
+	entry->value = value;
+	entry->free_heap = ESP.getFreeHeap();
+	entry->max_block = ESP.getMaxFreeBlockSize();
+	entry->stack_free = ESP.getFreeContStack();
+	entry->event = event;
+	_trace_next = (_trace_next + 1) % TRACE_SIZE;
+	if (_trace_count < TRACE_SIZE) _trace_count++;
+}
+
+
+/* Number of samples available */
+int trace_count() {
+	return _trace_count;
+}
+
+
+/* Get a sample, 0 = oldest one still available */
+TRACE_ENTRY_T *trace_get(int index) {
+	if (index<0 || index>=_trace_count) return NULL;
+	return &_trace[(_trace_next - _trace_count + index + TRACE_SIZE) % TRACE_SIZE];
+}
+
+
+/* Get the newest sample of an event, or NULL */
+TRACE_ENTRY_T *trace_find(uint8_t event) {
+	for (int i=_trace_count-1; i>=0; i--) {
+		TRACE_ENTRY_T *entry = trace_get(i);
+		if (entry->event == event) return entry;
+	}
+	return NULL;
+}
+
+
+/* Readable name of an event */
+const char *trace_event_name(uint8_t event) {
+	return (event<TRACE_EVENT_COUNT)?_trace_names[event]:"?";
+}
+
+
+/* Format one sample as a line of text, returns length */
+int trace_format(char *buf, int size, TRACE_ENTRY_T *entry) {
+	return snprintf(buf, size, "%8lu ms  %-16s heap %5u  block %5u  stack %4u  %lu\n",
+		(unsigned long)entry->ms, trace_event_name(entry->event),
+		entry->free_heap, entry->max_block, entry->stack_free,
+		(unsigned long)entry->value);
+}
+
+
+/* Show all samples on Serial, if we're debugging */
+void trace_show() {
+	#ifdef DEBUG_MODE
+	char buf[100];
+	Serial.println(F("Boot trace:"));
+	for (int i=0; i<trace_count(); i++) {
+		trace_format(buf, sizeof(buf), trace_get(i));
+		Serial.print(buf);
+	}
+	#endif
+}
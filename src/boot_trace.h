@@ -0,0 +1,75 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* boot_trace.h - timing & heap samples at phase boundaries */
+
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <stdint.h>
+
+/* Events that can be traced; keep in sync with _trace_names in boot_trace.cpp */
+enum TRACE_EVENT_T : uint8_t {
+	TRACE_SETUP_START,
+	TRACE_SETTINGS_READ,
+	TRACE_WIFI_CONNECTED,
+	TRACE_MQTT_CONNECTED,
+	TRACE_MQTT_PUBLISHED,
+	TRACE_ACTIONS_DONE,
+	TRACE_REST_DONE,
+	TRACE_SETUP_DONE,
+	TRACE_AP_START,
+	TRACE_AP_ROOT,
+	TRACE_AP_FORM,
+	TRACE_AP_404,
+	TRACE_AP_STATS,
+	TRACE_PLAN_WIFI_FAST, // planner decisions, same order as PLAN_PHASE_T
+	TRACE_PLAN_WIFI_SLOW,
+	TRACE_PLAN_DIRECT,
+	TRACE_PLAN_MQTT,
+	TRACE_PLAN_ACTIONS,
+	TRACE_PLAN_REST,
+	TRACE_STRATEGY, // value = STRATEGY_*
+	TRACE_RF_CAL, // value = 1 if full calibration
+	TRACE_AP_TRIAL, // value = 1 wifi ok, 2 wifi & MQTT ok
+	TRACE_AP_PROBE, // first OS captive portal check, value = index in _probes
+	TRACE_AP_UPDATE, // firmware upload (part) received, value = bytes/s
+	TRACE_DIRECT_DONE, // value = 1 if the direct trigger was delivered
+	TRACE_EVENT_COUNT
+};
+
+struct TRACE_ENTRY_T { // size: 16 bytes
+	uint32_t ms;
+	uint32_t value; // event specific
+	uint16_t free_heap; // bytes; ESP-01 has < 64kB
+	uint16_t max_block; // largest free heap block
+	uint16_t stack_free; // lowest free stack seen so far
+	uint8_t event;
+};
+
+void trace_sample(uint8_t event, uint32_t value=0);
+int trace_count();
+TRACE_ENTRY_T *trace_get(int index);
+TRACE_ENTRY_T *trace_find(uint8_t event);
+const char *trace_event_name(uint8_t event);
+int trace_format(char *buf, int size, TRACE_ENTRY_T *entry);
+void trace_show();
+
+#endif
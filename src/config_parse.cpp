@@ -0,0 +1,73 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* config_parse.cpp */
+
+/* Only plain C here, no Arduino, so the native tests in test/ can check
+ * how pushed configs are split into settings.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "config_parse.h"
+
+#define FNV_OFFSET 2166136261UL
+#define FNV_PRIME 16777619UL
+
+
+/* 32 bit FNV-1a hash */
+uint32_t config_hash(const char *text, int len) {
+	uint32_t hash = FNV_OFFSET;
+	for (int i=0; i<len; i++) {
+		hash ^= (uint8_t)text[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+
+/* Split text into "name=value" lines (changes text) & call fn for each;
+ * "#" lines, empty lines & a "\r" before the "\n" are fine. Returns the
+ * number of changed settings; lines without "=" & those fn rejects are
+ * counted in errors.
+ */
+int config_parse(char *text, CONFIG_LINE_FN fn, void *ctx, int *errors) {
+	int changes = 0;
+	*errors = 0;
+	char *line = text;
+	while (line && *line) {
+		char *next = strchr(line, '\n');
+		if (next) *next++ = 0;
+		int len = strlen(line);
+		if (len && line[len-1]=='\r') line[len-1] = 0;
+		char *value = strchr(line, '=');
+		if (value && (line[0] != '#')) {
+			*value++ = 0;
+			int res = fn(line, value, ctx);
+			if (res < 0) (*errors)++;
+			if (res > 0) changes++;
+		} else if (line[0] && (line[0] != '#')) {
+			(*errors)++;
+		}
+		line = next;
+	}
+	return changes;
+}
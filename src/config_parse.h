@@ -0,0 +1,36 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* config_parse.h - "name=value" lines of config_sync.cpp */
+
+#ifndef CONFIG_PARSE_H
+#define CONFIG_PARSE_H
+
+#include <stdint.h>
+
+/* Called per "name=value" line: returns 1 if the setting changed, 0 if
+ * not, -1 if the name or value isn't valid.
+ */
+typedef int (*CONFIG_LINE_FN)(const char *name, const char *value, void *ctx);
+
+uint32_t config_hash(const char *text, int len);
+int config_parse(char *text, CONFIG_LINE_FN fn, void *ctx, int *errors);
+
+#endif
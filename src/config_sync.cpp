@@ -0,0 +1,116 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* config_sync.cpp */
+
+/* Settings can be pushed to a device with two retained MQTT topics:
+ *
+ *   softplus/<client id>/config/set   "name=value" lines, names as in
+ *                                     g_settings_fields (settings_fields.cpp)
+ *   softplus/<client id>/config/hash  FNV-1a hash of config/set, in hex
+ *
+ * After the press was published, the device gets the small hash topic
+ * and compares it with the hash of the config it applied last. Only if
+ * they differ does it get config/set, checks its hash, applies it, and
+ * reports "hash,changes,errors" on softplus/<client id>/config/state.
+ * Devices without a config topic only check every CONFIG_IDLE_SKIP
+ * presses. tools/config_push.py creates both topics.
+ */
+
+#include <Arduino.h>
+
+#include "main.h"
+#include "settings.h"
+#include "config_sync.h"
+#include "mqtt_helper.h"
+
+
+/* State of config_apply() for _apply_line() */
+struct CONFIG_APPLY_T {
+	WIFI_SETTINGS_T *data;
+	bool reconnect;
+};
+
+
+/* Set one setting, for config_parse() */
+static int _apply_line(const char *name, const char *value, void *ctx) {
+	CONFIG_APPLY_T *apply = (CONFIG_APPLY_T *)ctx;
+	const SETTINGS_FIELD_T *field = settings_field_find(name);
+	int res = field?settings_field_set(field, apply->data, value):-1;
+	if ((res > 0) && (field->type & FIELD_RECONNECT)) apply->reconnect = true;
+	return res;
+}
+
+
+/* Apply "name=value" lines (changes text), returns the number of changed
+ * settings; unknown names & invalid values are counted in errors.
+ */
+int config_apply(WIFI_SETTINGS_T *data, char *text, int *errors) {
+	CONFIG_APPLY_T apply = { data, false };
+	int changes = config_parse(text, _apply_line, &apply, errors);
+	if (changes) compile_settings_templates(data);
+	if (apply.reconnect) data->wifi_channel = 0; // forces traditional wifi connect next
+	return changes;
+}
+
+
+/* Check for & apply a new remote config; call it after the press was
+ * published. Returns true if the settings changed & need to be saved.
+ * Skipped presses are counted on sampled presses only, by weight.
+ */
+bool config_sync(WIFI_SETTINGS_T *data, uint8_t weight) {
+	if (data->config_skip) {
+		if (!weight) return false;
+		data->config_skip = (data->config_skip > weight)?(data->config_skip - weight):0;
+		return true;
+	}
+	DEBUG_LOG("config_sync()");
+	char topic[100], hash_text[12];
+	snprintf(topic, sizeof(topic), "softplus/%s/config/hash", data->mqtt_client_id);
+	if (mqtt_fetch_retained(topic, hash_text, sizeof(hash_text), CONFIG_WAIT_MS) < 0) {
+		data->config_skip = CONFIG_IDLE_SKIP;
+		return true;
+	}
+	uint32_t wanted = strtoul(hash_text, NULL, 16);
+	if (wanted == data->config_hash) return false; // the usual case
+
+	// new config, rare enough to use the heap
+	char *text = (char *)malloc(CONFIG_MAX_SIZE);
+	if (!text) return false;
+	snprintf(topic, sizeof(topic), "softplus/%s/config/set", data->mqtt_client_id);
+	int len = mqtt_fetch_retained(topic, text, CONFIG_MAX_SIZE, CONFIG_WAIT_MS);
+	char state_topic[100], state[40];
+	// reported with the client id we were asked with
+	snprintf(state_topic, sizeof(state_topic), "softplus/%s/config/state", data->mqtt_client_id);
+	int changes = 0, errors = 0;
+	bool applied = false;
+	if ((len < 0) || (config_hash(text, len) != wanted)) {
+		// config/set not there or not updated yet, try again next press
+		snprintf(state, sizeof(state), "%08lx,0,mismatch", (unsigned long)wanted);
+	} else {
+		changes = config_apply(data, text, &errors);
+		data->config_hash = wanted; // even with errors, don't retry the same
+		applied = true;
+		snprintf(state, sizeof(state), "%08lx,%i,%i", (unsigned long)wanted, changes, errors);
+	}
+	free(text);
+	mqtt_send_topic(state_topic, state);
+	return applied; // config_hash at least
+}
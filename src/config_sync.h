@@ -0,0 +1,36 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* config_sync.h - settings pushed to the device over MQTT */
+
+#ifndef CONFIG_SYNC_H
+#define CONFIG_SYNC_H
+
+#include "settings.h"
+#include "config_parse.h"
+
+#define CONFIG_WAIT_MS 300 // for the retained message after subscribing
+#define CONFIG_IDLE_SKIP 10 // about that many presses skipped without a config topic
+#define CONFIG_MAX_SIZE 1024 // bytes, for softplus/<id>/config/set
+
+int config_apply(WIFI_SETTINGS_T *data, char *text, int *errors);
+bool config_sync(WIFI_SETTINGS_T *data, uint8_t weight);
+
+#endif
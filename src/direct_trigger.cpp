@@ -0,0 +1,81 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* direct_trigger.cpp */
+
+/* Sends the press straight to the device it controls, e.g. WLED's JSON
+ * API, instead of button -> MQTT broker -> device. The target's address
+ * is resolved with the wifi cache (see build_settings_from_wifi()), so a
+ * press needs no DNS or mDNS lookup. MQTT, if set up, follows afterwards,
+ * e.g. for state.
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "main.h"
+#include "settings.h"
+#include "action_helper.h"
+#include "direct_trigger.h"
+
+
+/* Send direct_value to direct_target: as one UDP datagram for udp://,
+ * or as HTTP POST (GET if empty) for http://, waiting for a 2xx status.
+ * Returns true if delivered; on false, the cached address may be stale.
+ */
+bool direct_send(WIFI_SETTINGS_T *data, uint32_t timeout_ms) {
+	DEBUG_LOG("direct_send()");
+	if (!data->direct_ip) return false;
+	char host[50];
+	uint16_t port;
+	const char *path;
+	IPAddress ip(data->direct_ip);
+
+	if (action_parse_url(data->direct_target, "udp://", 0, host, sizeof(host), &port, &path)) {
+		// fire & forget, nothing to wait for
+		WiFiUDP udp;
+		if (!udp.beginPacket(ip, port)) return false;
+		udp.write((const uint8_t *)data->direct_value, strlen(data->direct_value));
+		return udp.endPacket();
+	}
+	if (!action_parse_url(data->direct_target, "http://", 80, host, sizeof(host), &port, &path)) {
+		DEBUG_LOG("direct_send(): invalid target");
+		return false;
+	}
+	char buf[250];
+	int len = action_http_request(buf, sizeof(buf), host, path, data->direct_value);
+	if (len<0) return false;
+
+	uint32_t start = millis();
+	WiFiClient client;
+	client.setTimeout(timeout_ms);
+	client.setNoDelay(true); // request goes out in one segment
+	if (!client.connect(ip, port)) return false;
+	if (client.write((const uint8_t *)buf, len) != (size_t)len) return false;
+	while (!client.available() && client.connected() && (millis() - start < timeout_ms)) delay(1);
+	// "HTTP/1.1 200 OK" - only the status code matters
+	char status[13];
+	len = client.readBytes(status, sizeof(status)-1);
+	status[len] = 0;
+	int code = (len>9)?atoi(status+9):0;
+	client.stop();
+	return (code>=200) && (code<300);
+}
@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* energy.cpp */
+
+/* Estimates the charge a press takes from the battery. The power latch
+ * keeps the device on from the press until loop() lets go, so every ms
+ * counts; each phase's time from the boot trace is multiplied by the
+ * current of the radio state it's mostly in. The blinking afterwards
+ * hasn't happened yet when the metrics are sent, so it's added from
+ * BLINK_MS. tools/connect_sim.py uses the same profile.
+ */
+
+#include <Arduino.h>
+
+#include "main.h"
+#include "energy.h"
+#include "boot_trace.h"
+#include "rf_cal.h"
+
+extern unsigned long g_boot_millis;
+
+static const char * const _energy_names[ENERGY_PHASE_COUNT] = {
+	"boot", "cal", "settings", "wifi", "send", "blink", "led"
+};
+
+
+/* Charge in 0.1 uAh for ms at current_ma, with tx_pct % of it at TX
+ */
+static uint32_t _charge(uint32_t ms, uint32_t current_ma, uint32_t tx_pct) {
+	uint32_t ma_x100 = current_ma * (100 - tx_pct) + ENERGY_TX_MA * tx_pct;
+	return (uint32_t)((uint64_t)ms * ma_x100 / 36000);
+}
+
+
+/* Time between two traced events, or from the first one to now if the
+ * second one wasn't seen; 0 if the first one wasn't either.
+ */
+static uint32_t _phase_ms(uint8_t from_event, uint8_t to_event, uint32_t now) {
+	TRACE_ENTRY_T *from = trace_find(from_event);
+	TRACE_ENTRY_T *to = trace_find(to_event);
+	if (!from) return 0;
+	return (to?to->ms:now) - from->ms;
+}
+
+
+/* Estimate the charge used by this press so far, per phase, plus the
+ * blinking in loop() if blink is set.
+ */
+void energy_estimate(ENERGY_T *out, bool blink) {
+	uint32_t now = millis();
+	uint32_t cal_start = rf_cal_pre_init_ms();
+	uint32_t blink_ms = blink?BLINK_MS:0;
+	// on for every other step, starting with the first one
+	uint32_t blink_on_ms = blink?((BLINK_MS/BLINK_STEP_MS + 1)/2*BLINK_STEP_MS):0;
+	bool connected = trace_find(TRACE_WIFI_CONNECTED) != NULL;
+
+	out->phase[ENERGY_BOOT] = _charge(cal_start, ENERGY_CPU_MA, 0);
+	out->phase[ENERGY_CAL] = _charge(g_boot_millis - cal_start, ENERGY_TX_MA, 0);
+	out->phase[ENERGY_SETTINGS] = _charge(_phase_ms(TRACE_SETUP_START, TRACE_SETTINGS_READ, now),
+		ENERGY_CPU_MA, 0);
+	out->phase[ENERGY_WIFI] = _charge(_phase_ms(TRACE_SETTINGS_READ, TRACE_WIFI_CONNECTED, now),
+		ENERGY_RX_MA, ENERGY_WIFI_TX_PCT);
+	out->phase[ENERGY_SEND] = connected?_charge(_phase_ms(TRACE_WIFI_CONNECTED, TRACE_SETUP_DONE, now),
+		ENERGY_RX_MA, ENERGY_SEND_TX_PCT):0;
+	out->phase[ENERGY_BLINK] = _charge(blink_ms, ENERGY_IDLE_MA, 0);
+	// the LED goes on first thing in setup()
+	out->phase[ENERGY_LED] = _charge(now - g_boot_millis + blink_on_ms, ENERGY_LED_MA, 0);
+
+	out->total = 0;
+	for (int i=0; i<ENERGY_PHASE_COUNT; i++) out->total += out->phase[i];
+}
+
+
+/* Readable name of a phase */
+const char *energy_phase_name(uint8_t phase) {
+	return (phase<ENERGY_PHASE_COUNT)?_energy_names[phase]:"?";
+}
+
+
+/* Show the estimate on Serial, if we're debugging */
+void energy_show(ENERGY_T *energy) {
+	#ifdef DEBUG_MODE
+	char buf[60];
+	Serial.println(F("Energy:"));
+	for (int i=0; i<ENERGY_PHASE_COUNT; i++) {
+		snprintf(buf, sizeof(buf), "  %-10s %5lu.%lu uAh", energy_phase_name(i),
+			(unsigned long)(energy->phase[i]/10), (unsigned long)(energy->phase[i]%10));
+		Serial.println(buf);
+	}
+	snprintf(buf, sizeof(buf), "  %-10s %5lu.%lu uAh", "total",
+		(unsigned long)(energy->total/10), (unsigned long)(energy->total%10));
+	Serial.println(buf);
+	#endif
+}
@@ -0,0 +1,60 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* energy.h - charge used per press, from the boot trace & a current profile */
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdint.h>
+
+// current draw per state in mA; rough ESP-01 figures, measure your own board
+#define ENERGY_TX_MA 170 // transmitting, also RF calibration
+#define ENERGY_RX_MA 56 // radio on, receiving or listening
+#define ENERGY_IDLE_MA 20 // connected, nothing to send (modem sleep)
+#define ENERGY_CPU_MA 15 // radio off
+#define ENERGY_LED_MA 3 // on top of the above, while the LED is on
+
+// share of the time spent transmitting, in %
+#define ENERGY_WIFI_TX_PCT 5 // probe requests, authentication, DHCP
+#define ENERGY_SEND_TX_PCT 10 // TCP handshakes, requests, publishing
+
+/* Phases of a press; keep in sync with _energy_names in energy.cpp */
+enum ENERGY_PHASE_T : uint8_t {
+	ENERGY_BOOT, // power-on to RF init, CPU only
+	ENERGY_CAL, // RF calibration, until setup()
+	ENERGY_SETTINGS, // reading the settings
+	ENERGY_WIFI, // connecting, until connected or given up
+	ENERGY_SEND, // direct trigger, MQTT, actions, REST & metrics
+	ENERGY_BLINK, // blinking in loop() after a good press, estimated
+	ENERGY_LED, // the LED, during all of the above
+	ENERGY_PHASE_COUNT
+};
+
+struct ENERGY_T {
+	uint32_t phase[ENERGY_PHASE_COUNT]; // in 0.1 uAh
+	uint32_t total;
+};
+
+void energy_estimate(ENERGY_T *out, bool blink);
+const char *energy_phase_name(uint8_t phase);
+void energy_show(ENERGY_T *energy);
+
+#endif
@@ -0,0 +1,147 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* latency_hist.cpp */
+
+/* Counts press latencies in HIST_BUCKETS buckets on a roughly
+ * logarithmic scale (1-1.5-2-3-5 steps), for the whole press and the
+ * wifi & MQTT phases, plus how many presses went the fast or the slow
+ * way or failed. It lives in the settings; to spare the flash, a good
+ * press only counts when it's sampled for statistics (STATS_SAMPLE_ONE_IN,
+ * main.h), as that many presses, while failures always count. Every
+ * HIST_SUMMARY_EVERY presses the percentiles are published.
+ */
+
+#include <Arduino.h>
+
+#include "main.h"
+#include "settings.h"
+#include "latency_hist.h"
+#include "boot_trace.h"
+
+// upper bounds in ms; the last bucket takes everything above
+static const uint16_t _bucket_max[HIST_BUCKETS-1] = {
+	20, 30, 50, 75, 100, 150, 200, 300, 500, 750, 1000, 1500, 2000, 3000, 5000
+};
+static const char * const _series_names[HIST_SERIES] = { "total", "wifi", "mqtt" };
+
+
+/* Halves all buckets & counters together, so they never overflow and
+ * the series stay comparable.
+ */
+static void _halve(WIFI_SETTINGS_T *data) {
+	for (int s=0; s<HIST_SERIES; s++) {
+		for (int i=0; i<HIST_BUCKETS; i++) data->hist[s][i] /= 2;
+	}
+	data->hist_fast /= 2; data->hist_slow /= 2; data->hist_fail /= 2;
+}
+
+
+/* Whether any bucket or counter would overflow by adding weight */
+static bool _full(WIFI_SETTINGS_T *data, uint8_t weight) {
+	for (int s=0; s<HIST_SERIES; s++) {
+		for (int i=0; i<HIST_BUCKETS; i++) {
+			if (data->hist[s][i] > 0xFFFF - weight) return true;
+		}
+	}
+	return (data->hist_fast > 0xFFFF - weight) || (data->hist_slow > 0xFFFF - weight)
+		|| (data->hist_fail > 0xFFFF - weight);
+}
+
+
+/* Count one value in a series */
+static void _add(uint16_t *buckets, uint32_t ms, uint8_t weight) {
+	int i = 0;
+	while ((i < HIST_BUCKETS-1) && (ms > _bucket_max[i])) i++;
+	buckets[i] += weight;
+}
+
+
+/* Time between two traced events, or -1 if one of them is missing */
+static int32_t _between(uint8_t from_event, uint8_t to_event) {
+	TRACE_ENTRY_T *from = trace_find(from_event);
+	TRACE_ENTRY_T *to = trace_find(to_event);
+	if (!from || !to) return -1;
+	return to->ms - from->ms;
+}
+
+
+/* Record this press, from the boot trace, with the weight of the press
+ * (0 if not sampled); returns true if the settings changed & need to be
+ * saved.
+ */
+bool hist_record(WIFI_SETTINGS_T *data, bool ok, bool fast_path, uint8_t weight) {
+	if (!ok) weight = 1;
+	else if (!weight) return false;
+	if (_full(data, weight)) _halve(data);
+	uint16_t *counter = !ok?&data->hist_fail:(fast_path?&data->hist_fast:&data->hist_slow);
+	*counter += weight;
+	data->hist_since_summary = min(0xFFFF, data->hist_since_summary + weight);
+	if (!ok) return true;
+
+	// done = the message went out, via MQTT or else REST
+	TRACE_ENTRY_T *done = trace_find(TRACE_MQTT_PUBLISHED);
+	if (!done) done = trace_find(TRACE_REST_DONE);
+	if (done) _add(data->hist[HIST_TOTAL], done->ms, weight); // millis() start at power-on
+	int32_t ms = _between(TRACE_SETUP_START, TRACE_WIFI_CONNECTED);
+	if (ms >= 0) _add(data->hist[HIST_WIFI], ms, weight);
+	ms = _between(TRACE_WIFI_CONNECTED, TRACE_MQTT_PUBLISHED);
+	if (ms >= 0) _add(data->hist[HIST_MQTT], ms, weight);
+	return true;
+}
+
+
+/* Upper bound of the bucket holding the pct-th percentile, in ms;
+ * 0 if empty, HIST_OVERFLOW for the last bucket.
+ */
+uint16_t hist_percentile(const uint16_t *buckets, int pct) {
+	uint32_t total = 0;
+	for (int i=0; i<HIST_BUCKETS; i++) total += buckets[i];
+	if (!total) return 0;
+	uint32_t rank = (total * pct + 99) / 100; // 1-based, rounded up
+	uint32_t seen = 0;
+	for (int i=0; i<HIST_BUCKETS-1; i++) {
+		seen += buckets[i];
+		if (seen >= rank) return _bucket_max[i];
+	}
+	return HIST_OVERFLOW;
+}
+
+
+/* Whether it's time to publish a summary */
+bool hist_summary_due(WIFI_SETTINGS_T *data) {
+	return data->hist_since_summary >= HIST_SUMMARY_EVERY;
+}
+
+
+/* Summary as JSON, e.g. {"fast":45,"slow":4,"fail":1,"total":[300,750,1500],...}
+ * with p50, p95 & p99 per series; returns length.
+ */
+int hist_format_summary(char *buf, int size, WIFI_SETTINGS_T *data) {
+	int len = snprintf(buf, size, "{\"fast\":%u,\"slow\":%u,\"fail\":%u",
+		data->hist_fast, data->hist_slow, data->hist_fail);
+	for (int s=0; s<HIST_SERIES && len<size; s++) {
+		len += snprintf(buf+len, size-len, ",\"%s\":[%u,%u,%u]", _series_names[s],
+			hist_percentile(data->hist[s], 50), hist_percentile(data->hist[s], 95),
+			hist_percentile(data->hist[s], 99));
+	}
+	if (len < size) len += snprintf(buf+len, size-len, "}");
+	return len;
+}
@@ -0,0 +1,36 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* latency_hist.h - press latency histograms, kept in the settings */
+
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include "settings.h"
+
+#define HIST_SUMMARY_EVERY 50 // presses between summaries on MQTT
+#define HIST_OVERFLOW 0xFFFF // ms reported for the last, open-ended bucket
+
+bool hist_record(WIFI_SETTINGS_T *data, bool ok, bool fast_path, uint8_t weight);
+uint16_t hist_percentile(const uint16_t *buckets, int pct);
+bool hist_summary_due(WIFI_SETTINGS_T *data);
+int hist_format_summary(char *buf, int size, WIFI_SETTINGS_T *data);
+
+#endif
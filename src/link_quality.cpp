@@ -0,0 +1,154 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* link_quality.cpp */
+
+/* After every fast connect we keep running averages of the RSSI, the
+ * association time and the TCP connect time to the broker. When a press
+ * is clearly worse than the average, the cache is refreshed in loop(),
+ * while the LED blinks and the press has already been published: an
+ * async scan of our channel looks for a stronger BSSID of our SSID (a
+ * single channel takes ~100 ms, all of them longer than the blinking),
+ * and after the blinking build_settings_from_wifi() re-reads IP, DNS and
+ * broker address, which can block. If the device powers down before that
+ * finishes, the flag stays set and the next press tries again.
+ */
+
+#include <Arduino.h>
+
+#include "main.h"
+#include "settings.h"
+#include "link_quality.h"
+
+static bool _scanning = false;
+static bool _scanned = false; // done, link_refresh_finish() is next
+static uint8_t _best_bssid[6]; // a stronger BSSID the scan found
+static uint8_t _best_channel = 0; // and its channel; 0 = none
+
+
+/* Moves an average 1/LINK_EWMA_DIV towards value */
+static int32_t _ewma(int32_t average, int32_t value) {
+	return average + (value - average) / LINK_EWMA_DIV;
+}
+
+
+/* Record the link after a successful fast connect, returns true if it
+ * drifted from the averages & a refresh is scheduled.
+ */
+bool link_record(WIFI_SETTINGS_T *data, int32_t rssi, uint32_t assoc_ms, uint32_t tcp_ms) {
+	if ((rssi >= 0) || (rssi < -127)) return false; // not connected
+	if (assoc_ms > 0xFFFF) assoc_ms = 0xFFFF;
+	if (tcp_ms > 0xFFFF) tcp_ms = 0xFFFF;
+
+	bool drift = false;
+	if (!data->link_rssi) {
+		// first press after a refresh, start new averages
+		data->link_rssi = rssi;
+		data->link_assoc_ms = assoc_ms;
+		data->link_tcp_ms = tcp_ms;
+	} else {
+		drift = (rssi < data->link_rssi - LINK_RSSI_DROP)
+			|| (assoc_ms > 2 * (uint32_t)data->link_assoc_ms + LINK_ASSOC_SLACK)
+			|| (tcp_ms > 2 * (uint32_t)data->link_tcp_ms + LINK_TCP_SLACK);
+		data->link_rssi = _ewma(data->link_rssi, rssi);
+		data->link_assoc_ms = _ewma(data->link_assoc_ms, assoc_ms);
+		data->link_tcp_ms = _ewma(data->link_tcp_ms, tcp_ms);
+	}
+	if (drift) data->link_refresh = 1;
+	DEBUG_LOG1("link_record() dBm", rssi);
+	DEBUG_LOG1("link_record() assoc ms", assoc_ms);
+	DEBUG_LOG1("link_record() tcp ms", tcp_ms);
+	if (drift) {
+		DEBUG_LOG1("link_record() drifted, avg dBm", data->link_rssi);
+	}
+	return drift;
+}
+
+
+/* Start the background refresh if one is scheduled, returns true if
+ * it was started.
+ */
+bool link_refresh_begin(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w) {
+	if (!data->link_refresh || _scanning || _scanned) return false;
+	DEBUG_LOG("link_refresh_begin()");
+	// async, only our SSID & channel; we stay associated meanwhile
+	_scanning = (w->scanNetworks(true, false, data->wifi_channel,
+		(uint8_t *)data->wifi_ssid) == WIFI_SCAN_RUNNING);
+	return _scanning;
+}
+
+
+/* Check on the scan, returns true once it's done (or there's none).
+ * Call it until then, it doesn't block.
+ */
+bool link_refresh_poll(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w) {
+	if (!_scanning) return true;
+	int8_t found = w->scanComplete();
+	if (found == WIFI_SCAN_RUNNING) return false;
+	_scanning = false;
+	_scanned = true;
+	DEBUG_LOG("link_refresh_poll() scan done");
+
+	// keep the strongest BSSID for build_settings_from_wifi() to see
+	int32_t current = w->RSSI();
+	int best = -1;
+	for (int i=0; i<found; i++) {
+		if (strcmp(w->SSID(i).c_str(), data->wifi_ssid)) continue;
+		if ((best < 0) || (w->RSSI(i) > w->RSSI(best))) best = i;
+	}
+	if ((best >= 0) && (w->RSSI(best) >= current + LINK_BETTER_DB)) {
+		// next press associates with the stronger one
+		memcpy(_best_bssid, w->BSSID(best), 6);
+		_best_channel = w->channel(best);
+		DEBUG_LOG1("link_refresh_poll() switching BSSID, dBm", w->RSSI(best));
+		DEBUG_LOG1("link_refresh_poll() switching BSSID, channel", _best_channel);
+	}
+	w->scanDelete();
+	return true;
+}
+
+
+/* Complete the refresh after the blinking, once the scan is done: re-reads
+ * the addresses, which can block. Returns true if the settings changed &
+ * need to be saved; false if there was no refresh or the scan didn't
+ * finish, then the next press tries again.
+ */
+bool link_refresh_finish(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w) {
+	if (_scanning) {
+		w->scanDelete(); // took too long, don't hold the power for it
+		_scanning = false;
+		return false;
+	}
+	if (!_scanned) return false;
+	_scanned = false;
+	DEBUG_LOG("link_refresh_finish()");
+	// re-read addresses & the BSSID/channel we're on now
+	build_settings_from_wifi(data, w);
+	if (_best_channel) {
+		// next press associates with the stronger one
+		memcpy(data->wifi_bssid, _best_bssid, 6);
+		data->wifi_channel = _best_channel;
+		_best_channel = 0;
+	}
+	// new link, new averages
+	data->link_refresh = 0;
+	data->link_rssi = 0;
+	return true;
+}
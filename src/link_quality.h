@@ -0,0 +1,41 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* link_quality.h - refreshes the wifi cache when the link gets worse */
+
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <ESP8266WiFi.h>
+#include "settings.h"
+
+#define LINK_EWMA_DIV 4 // new sample weighs 1/4 in the averages
+#define LINK_RSSI_DROP 8 // dB weaker than average counts as drift
+#define LINK_ASSOC_SLACK 150 // ms, association slower than 2x average + this
+#define LINK_TCP_SLACK 50 // ms, TCP connect slower than 2x average + this
+#define LINK_BETTER_DB 6 // another BSSID this much stronger replaces ours
+#define LINK_SCAN_MAX_MS 1000 // waiting for the scan after the blinking, at most
+
+bool link_record(WIFI_SETTINGS_T *data, int32_t rssi, uint32_t assoc_ms, uint32_t tcp_ms);
+bool link_refresh_begin(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w);
+bool link_refresh_poll(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w);
+bool link_refresh_finish(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w);
+
+#endif
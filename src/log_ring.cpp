@@ -0,0 +1,107 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* log_ring.cpp */
+
+/* With DEBUG_LOG_RING, DEBUG_LOG() only stores the time, the address of
+ * its text in flash and, for DEBUG_LOG1(), a value here, which takes about a microsecond
+ * instead of a millisecond or more at 115200 baud. The records are
+ * printed by log_ring_drain(), after the press was published or while
+ * idle in AP mode. If DEBUG_LOG_UDP_HOST is set, the raw records are
+ * also sent there while wifi is up; tools/log_decode.py turns them back
+ * into text using the firmware's .elf file.
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "main.h"
+#include "log_ring.h"
+
+static LOG_RECORD_T _ring[LOG_RING_SIZE];
+static int _ring_start; // oldest record
+static int _ring_count;
+static uint16_t _ring_dropped; // since the last drain
+
+
+/* Store a record; if the ring is full, the new one is dropped so that
+ * the start of the boot stays visible.
+ */
+void log_ring_add(PGM_P fmt, int32_t arg) {
+	if (_ring_count >= LOG_RING_SIZE) {
+		if (_ring_dropped < 0xFFFF) _ring_dropped++;
+		return;
+	}
+	LOG_RECORD_T *rec = &_ring[(_ring_start + _ring_count) % LOG_RING_SIZE];
+	rec->ms = millis();
+	rec->fmt = (uint32_t)fmt;
+	rec->arg = arg;
+	_ring_count++;
+}
+
+
+/* Number of records waiting */
+int log_ring_count() {
+	return _ring_count;
+}
+
+
+#ifdef DEBUG_LOG_UDP_HOST
+/* Send the waiting records as one packet: magic, count, dropped, records */
+static void _send_udp() {
+	if (WiFi.status() != WL_CONNECTED) return;
+	IPAddress host;
+	if (!host.fromString(DEBUG_LOG_UDP_HOST)) return;
+	WiFiUDP udp;
+	uint16_t header[2] = { (uint16_t)_ring_count, _ring_dropped };
+	udp.beginPacket(host, LOG_RING_UDP_PORT);
+	udp.write((const uint8_t *)LOG_RING_MAGIC, 4);
+	udp.write((const uint8_t *)header, sizeof(header));
+	for (int i=0; i<_ring_count; i++) {
+		udp.write((const uint8_t *)&_ring[(_ring_start + i) % LOG_RING_SIZE], sizeof(LOG_RECORD_T));
+	}
+	udp.endPacket();
+}
+#endif
+
+
+/* Print & empty the ring; slow, keep it off the hot path */
+void log_ring_drain() {
+	if (!_ring_count && !_ring_dropped) return;
+	#ifdef DEBUG_LOG_UDP_HOST
+	_send_udp();
+	#endif
+	char text[80];
+	while (_ring_count) {
+		LOG_RECORD_T *rec = &_ring[_ring_start];
+		strncpy_P(text, (PGM_P)rec->fmt, sizeof(text));
+		text[sizeof(text)-1] = 0;
+		Serial.print(text); Serial.print(F(" @ ")); Serial.print(rec->ms);
+		if (rec->arg != LOG_RING_NO_ARG) { Serial.print(F(" = ")); Serial.print(rec->arg); }
+		Serial.println();
+		_ring_start = (_ring_start + 1) % LOG_RING_SIZE;
+		_ring_count--;
+	}
+	if (_ring_dropped) {
+		Serial.print(F("Log ring full, dropped: ")); Serial.println(_ring_dropped);
+		_ring_dropped = 0;
+	}
+}
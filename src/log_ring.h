@@ -0,0 +1,43 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* log_ring.h - debug log records in RAM, printed later */
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <Arduino.h>
+
+#define LOG_RING_SIZE 96 // records, 12 bytes each
+#define LOG_RING_UDP_PORT 5514 // default port for DEBUG_LOG_UDP_HOST
+#define LOG_RING_MAGIC "SPLR" // start of each UDP packet
+#define LOG_RING_NO_ARG INT32_MIN // arg of DEBUG_LOG(), which has no value
+
+struct LOG_RECORD_T { // size: 12 bytes, sent as-is over UDP
+	uint32_t ms;
+	uint32_t fmt; // address of the PROGMEM text, look it up in firmware.elf
+	int32_t arg; // value of DEBUG_LOG1(), or LOG_RING_NO_ARG
+};
+
+void log_ring_add(PGM_P fmt, int32_t arg);
+int log_ring_count();
+void log_ring_drain();
+
+#endif
@@ -29,15 +29,35 @@
 #include "wifi_helper.h"
 #include "mqtt_helper.h"
 #include "ap_mode.h"
+#include "template_helper.h"
+#include "action_helper.h"
+#include "boot_trace.h"
+#include "benchmark.h"
+#include "planner.h"
+#include "strategy.h"
+#include "rf_cal.h"
+#include "link_quality.h"
+#include "metrics.h"
+#include "latency_hist.h"
+#include "config_sync.h"
+#include "direct_trigger.h"
+#include "energy.h"
+#if FEATURE_REST
 #include <ESP8266HTTPClient.h>
+#endif
 
 WIFI_SETTINGS_T g_wifi_settings;
 bool g_wifi_mqtt_working;
 unsigned long g_start_millis; // millis() counter at start
+unsigned long g_boot_millis; // millis() when setup() was called, i.e. time spent booting
 WiFiClient g_wclient;
+bool g_settings_dirty; // save settings once the press is handled
+
+ADC_MODE(ADC_VCC); // for {vcc} in templates, ESP-01 has no ADC pin anyway
 
 // functions that follow
 void countdown(int secs);
+void fill_template_context(TEMPLATE_CONTEXT_T *ctx);
 
 
 /* Main setup() function:
@@ -49,6 +69,7 @@ void countdown(int secs);
  *  6. (MCU continues with loop() below)
  */
 void setup() {
+	g_boot_millis = millis(); // includes RF calibration
 	#ifndef DEBUG_MODE
 	pinMode(NOTIFY_PIN, OUTPUT);
 	digitalWrite(NOTIFY_PIN, HIGH);
@@ -59,6 +80,13 @@ void setup() {
 	pinMode(LED_PIN, OUTPUT);
 	digitalWrite(LED_PIN, LOW); // LED on
 
+	#ifdef DEBUG_BENCHMARK
+	Serial.begin(115200);
+	delay(2000); // time to open the serial monitor
+	run_benchmarks();
+	while (true) delay(1000);
+	#endif
+
 	#ifdef DEBUG_MODE
 	Serial.begin(115200);
 	Serial.print("Starting soon...");
@@ -66,28 +94,67 @@ void setup() {
 	uint32_t finish_wifi_millis = 0;
 	#endif
 	g_start_millis = millis();
+	trace_sample(TRACE_SETUP_START, g_boot_millis);
+	trace_sample(TRACE_RF_CAL, rf_cal_was_full());
 
 	g_wifi_mqtt_working = false; // assume the worst
+	g_settings_dirty = false;
 	bool autodiscover_mqtt = false;
+	bool delivered = false; // by any of direct, MQTT or REST
+	TEMPLATE_CONTEXT_T tpl_context;
+	uint32_t budget; // ms, for the current phase
+	uint32_t fast_connect_ms = 0; // 0 = no fast connect
+	// is this press sampled for the statistics? see STATS_SAMPLE_ONE_IN
+	uint8_t stats_weight = (ESP.random() % STATS_SAMPLE_ONE_IN)?0:STATS_SAMPLE_ONE_IN;
 
 	DEBUG_LOG("\n## WIFI:");
-	if (!get_settings_from_flash(&g_wifi_settings)) {
+	bool have_settings = get_settings_from_flash(&g_wifi_settings);
+	trace_sample(TRACE_SETTINGS_READ);
+	if (!have_settings) {
 		// if we have no settings, start with default
 		default_settings(&g_wifi_settings);
 		g_wifi_mqtt_working = false;
 	} else {
 		// connect to wifi
-		#ifdef DEBUG_MODE
+		#if defined(DEBUG_MODE) && !defined(DEBUG_SERIAL_LATER)
 		show_settings(&g_wifi_settings);
 		#endif
-		// attempt fast connect first
-		g_wifi_mqtt_working = wifi_try_fast_connect(&g_wifi_settings, &WiFi);
+		// every phase gets a part of one deadline for the whole press
+		planner_begin(g_start_millis, g_wifi_settings.press_deadline_ms);
+		// use the connect strategy that has worked best here so far
+		uint8_t strategy = strategy_choose(&g_wifi_settings);
+		trace_sample(TRACE_STRATEGY, strategy);
+		uint32_t connect_start = millis();
+		if (strategy != STRATEGY_DHCP) {
+			budget = planner_budget(PLAN_WIFI_FAST);
+			if (budget) g_wifi_mqtt_working = wifi_try_fast_connect(&g_wifi_settings, &WiFi,
+				budget, strategy == STRATEGY_BSSID);
+			if (strategy_record(&g_wifi_settings, strategy, g_wifi_mqtt_working,
+					millis()-connect_start, stats_weight)) {
+				g_settings_dirty = true;
+			}
+			if (g_wifi_mqtt_working) fast_connect_ms = millis() - connect_start;
+		}
 		if (!g_wifi_mqtt_working) {
-			// traditional wifi connection
-			g_wifi_mqtt_working = wifi_try_slow_connect(&g_wifi_settings, &WiFi);
-			if (g_wifi_mqtt_working) save_settings_to_flash(&g_wifi_settings);
-			autodiscover_mqtt = true;
+			// a fallback if the fast connect failed or there's no cache yet;
+			// the bandit's DHCP arm is an ordinary press otherwise
+			bool fallback = (strategy != STRATEGY_DHCP)
+				|| !g_wifi_settings.ip_address || !g_wifi_settings.wifi_channel;
+			// traditional wifi connection, if there's still time for it
+			budget = planner_budget(PLAN_WIFI_SLOW);
+			connect_start = millis();
+			bool changed = false;
+			if (budget) g_wifi_mqtt_working = wifi_try_slow_connect(&g_wifi_settings, &WiFi,
+				budget, &changed);
+			// only a changed cache is saved, once, at the end of setup()
+			if (changed) g_settings_dirty = true;
+			if ((strategy == STRATEGY_DHCP) && strategy_record(&g_wifi_settings, strategy,
+					g_wifi_mqtt_working, millis()-connect_start, stats_weight)) {
+				g_settings_dirty = true;
+			}
+			if (fallback) autodiscover_mqtt = true;
 		}
+		if (rf_cal_update(&g_wifi_settings, g_wifi_mqtt_working, stats_weight)) g_settings_dirty = true;
 	}
 	#ifdef DEBUG_AUTODISCOVER
 	autodiscover_mqtt = true;
@@ -95,55 +162,148 @@ void setup() {
 	#ifdef DEBUG_MODE
 	finish_wifi_millis = millis();
 	#endif
-	
+	if (g_wifi_mqtt_working) trace_sample(TRACE_WIFI_CONNECTED, autodiscover_mqtt?2:1); // 2=slow
+
 	DEBUG_LOG("\n## MQTT:");
+	uint8_t link_refresh = g_wifi_settings.link_refresh; // set by failed actions, too
 	if (g_wifi_mqtt_working) {
-		#ifdef DEBUG_MODE
+		#if defined(DEBUG_MODE) && !defined(DEBUG_SERIAL_LATER)
 		show_wifi_info(&WiFi);
 		#endif
-		#ifndef DEBUG_SKIP_MQTT
+		if (g_wifi_settings.tpl_flags & TPL_USES(TPL_OP_SEQ)) {
+			g_wifi_settings.press_seq++;
+			g_settings_dirty = true;
+		}
+		fill_template_context(&tpl_context);
+		// straight to the device it controls, before the broker hop
+		if (g_wifi_settings.direct_target[0] && (budget = planner_budget(PLAN_DIRECT))) {
+			bool sent = direct_send(&g_wifi_settings, budget);
+			trace_sample(TRACE_DIRECT_DONE, sent);
+			if (sent) delivered = true;
+			// its address may have changed; look it up again after the press
+			if (!sent) {
+				g_wifi_settings.link_refresh = 1;
+				g_settings_dirty = true;
+			}
+		}
+		#if FEATURE_MQTT && !defined(DEBUG_SKIP_MQTT)
 		// check if we have a MQTT hostname
 		if (g_wifi_settings.mqtt_host_str[0]) {
-			if (!mqtt_connect_server(&g_wclient, &g_wifi_settings)) {
+			budget = planner_budget(PLAN_MQTT);
+			if (!budget || !mqtt_connect_server(&g_wclient, &g_wifi_settings, budget)) {
 				DEBUG_LOG("mqtt_connect_server() FAILED");
 				g_wifi_mqtt_working = false;
 			}
 			if (g_wifi_mqtt_working) {
-				if (!mqtt_send_topic(g_wifi_settings.mqtt_topic, g_wifi_settings.mqtt_value)) {
+				trace_sample(TRACE_MQTT_CONNECTED);
+				tpl_context.ms = millis() - g_start_millis;
+				if (!mqtt_send_template(g_wifi_settings.mqtt_topic,
+						g_wifi_settings.mqtt_value_tpl, &tpl_context)) {
 					DEBUG_LOG("mqtt_send_topic(main) FAILED");
 					g_wifi_mqtt_working = false;
 				}
 			}
+			if (g_wifi_mqtt_working) {
+				trace_sample(TRACE_MQTT_PUBLISHED);
+				delivered = true;
+				// link quality; a drift is handled in loop(), after the press
+				if (fast_connect_ms && link_record(&g_wifi_settings, WiFi.RSSI(),
+						fast_connect_ms, mqtt_tcp_connect_ms())) {
+					g_settings_dirty = true; // the refresh flag, in case we lose power
+				}
+			}
+			// extra actions; the HTTP ones work even if the broker doesn't
+			budget = planner_budget(PLAN_ACTIONS);
+			if (budget) trace_sample(TRACE_ACTIONS_DONE,
+				actions_run(&g_wifi_settings, budget, g_wifi_mqtt_working));
 			if (g_wifi_mqtt_working) {
 				if (autodiscover_mqtt) {
 					mqtt_send_autodiscover(&g_wifi_settings);
 					mqtt_send_network_info(&WiFi, &g_wifi_settings);
 				}
 				mqtt_send_device_state(&g_wifi_settings);
+				// presses that didn't make it before this one
+				if (g_wifi_settings.missed_presses && mqtt_send_missed_presses(&g_wifi_settings)) {
+					g_wifi_settings.missed_presses = 0;
+					g_settings_dirty = true;
+				}
 			}
 		}
 		#endif
-		#ifndef DEBUG_SKIP_REST
+		// without MQTT, only the HTTP actions can work
+		if (!FEATURE_MQTT || !g_wifi_settings.mqtt_host_str[0]) {
+			budget = planner_budget(PLAN_ACTIONS);
+			if (budget) trace_sample(TRACE_ACTIONS_DONE, actions_run(&g_wifi_settings, budget, false));
+		}
+		if (g_wifi_settings.link_refresh != link_refresh) g_settings_dirty = true;
+		#if FEATURE_REST && !defined(DEBUG_SKIP_REST)
 			// check if we have a REST URL
-			if (g_wifi_settings.rest_url[0]) {
+			if (g_wifi_settings.rest_url[0] && (budget = planner_budget(PLAN_REST))) {
 				WiFiClient client;
 				HTTPClient http;
+				char url[200];
+				tpl_context.ms = millis() - g_start_millis;
+				template_render(url, sizeof(url), g_wifi_settings.rest_url_tpl, &tpl_context);
 				DEBUG_LOG("Requesting REST URL: ");
-				#ifdef DEBUG_MODE
-				Serial.println(g_wifi_settings.rest_url);
+				#if defined(DEBUG_MODE) && !defined(DEBUG_SERIAL_LATER)
+				Serial.println(url);
 				#endif
 
-				http.begin(client, g_wifi_settings.rest_url);
+				http.begin(client, url);
+				http.setTimeout(budget);
 		    	// Send HTTP GET request
       			int http_response_code = http.GET();
 				// ignore response code, we're done 
-				#ifdef DEBUG_MODE
+				trace_sample(TRACE_REST_DONE, http_response_code);
+				DEBUG_LOG1("REST response code", http_response_code);
+				if (http_response_code > 0) delivered = true;
+				#if defined(DEBUG_MODE) && !defined(DEBUG_SERIAL_LATER)
 				Serial.println(http_response_code);
 				#endif
 			}
 		#endif
 
 	}
+	// telemetry for this press, if there's a collector; fire & forget
+	if (have_settings && (WiFi.status() == WL_CONNECTED)) {
+		metrics_send(&g_wifi_settings, fast_connect_ms != 0, g_wifi_mqtt_working);
+	}
+	if (have_settings) {
+		// saved below, with everything else
+		if (hist_record(&g_wifi_settings, g_wifi_mqtt_working, fast_connect_ms != 0, stats_weight)) {
+			g_settings_dirty = true;
+		}
+		#if FEATURE_MQTT
+		if (g_wifi_mqtt_working && g_wifi_settings.mqtt_host_str[0]
+				&& hist_summary_due(&g_wifi_settings)
+				&& mqtt_send_latency_summary(&g_wifi_settings)) {
+			g_wifi_settings.hist_since_summary = 0;
+			g_settings_dirty = true;
+		}
+		#ifndef BAKED_CONFIG
+		// settings pushed over MQTT, if any; saved below too
+		if (g_wifi_mqtt_working && g_wifi_settings.mqtt_host_str[0]
+				&& config_sync(&g_wifi_settings, stats_weight)) {
+			g_settings_dirty = true;
+		}
+		#endif
+		#endif
+	}
+	// out of time or no way through: count it, the next good press reports it
+	if (have_settings && !delivered) {
+		if (g_wifi_settings.missed_presses < 0xFFFF) g_wifi_settings.missed_presses++;
+		g_settings_dirty = true;
+	}
+	// anything that changed while handling the press, e.g. press_seq
+	if (g_settings_dirty) save_settings_to_flash(&g_wifi_settings);
+	trace_sample(TRACE_SETUP_DONE, g_wifi_mqtt_working);
+
+	#ifdef DEBUG_SERIAL_LATER
+	// the press is done, now there's time for Serial
+	log_ring_drain();
+	show_settings(&g_wifi_settings);
+	if (g_wifi_mqtt_working) show_wifi_info(&WiFi);
+	#endif
 	#ifdef DEBUG_MODE
 	Serial.print("Result: ");
 	if (g_wifi_mqtt_working) Serial.println("OK"); else Serial.println("FAILED");
@@ -155,6 +315,15 @@ void setup() {
 	Serial.print("Time total: ");
 	Serial.print((millis()-g_start_millis));
 	Serial.println(" ms");
+	Serial.print("Time boot:  ");
+	Serial.print(g_boot_millis);
+	Serial.print(" ms, RF init @ ");
+	Serial.print(rf_cal_pre_init_ms());
+	Serial.println(rf_cal_was_full()?" ms, full calibration":" ms, quick calibration");
+	trace_show();
+	ENERGY_T energy;
+	energy_estimate(&energy, g_wifi_mqtt_working);
+	energy_show(&energy);
 	#endif
 	DEBUG_LOG("\n## setup() complete");
 }
@@ -168,6 +337,9 @@ void setup() {
  */
 void loop() {
 	DEBUG_LOG("\n#  loop()");
+	#ifdef DEBUG_SERIAL_LATER
+	log_ring_drain();
+	#endif
 
 	#ifdef DEBUG_AP_MODE
 	bool res = enable_ap_mode(&g_wifi_settings);
@@ -176,10 +348,19 @@ void loop() {
 
 	#ifndef DEBUG_MODE
 	if (g_wifi_mqtt_working) {
-		// @ ca 3s
-		for (int i=0; i<1500/100; i++) {
-			digitalWrite(LED_PIN, ((i%2)==0)?LOW:HIGH); delay(100);
+		// @ ca 3s; refresh the cache meanwhile, if the link drifted
+		bool refresh = link_refresh_begin(&g_wifi_settings, &WiFi);
+		for (int i=0; i<BLINK_MS/BLINK_STEP_MS; i++) {
+			digitalWrite(LED_PIN, ((i%2)==0)?LOW:HIGH); delay(BLINK_STEP_MS);
+			if (refresh && link_refresh_poll(&g_wifi_settings, &WiFi)) refresh = false;
 		}
+		if (refresh) {
+			// still scanning; a little longer, but not for long
+			uint32_t scan_end = millis() + LINK_SCAN_MAX_MS;
+			while (!link_refresh_poll(&g_wifi_settings, &WiFi) && (millis() < scan_end)) delay(10);
+		}
+		// the blocking part, now that the blinking is done
+		if (link_refresh_finish(&g_wifi_settings, &WiFi)) save_settings_to_flash(&g_wifi_settings);
 		// @ ca 5s
 		digitalWrite(LED_PIN, HIGH); // LED off
 		digitalWrite(NOTIFY_PIN, LOW); // should power down
@@ -190,6 +371,7 @@ void loop() {
 		delay(100);
 		// disconnect MQTT, reconnect Wifi, cache state, do autodiscovery
 		mqtt_disconnect();
+		// saves the new cache; a power drop during the write keeps the old one
 		bool res = wifi_try_slow_connect(&g_wifi_settings, &WiFi);
 		if (res) {
 			save_settings_to_flash(&g_wifi_settings);
@@ -200,12 +382,12 @@ void loop() {
 		}
 		// complete, @ ca 12s
 		digitalWrite(LED_PIN, HIGH); // LED off
-		delay(200); // wait a little
 		digitalWrite(NOTIFY_PIN, LOW); // power down again
 	}
 	// is anyone still pushing the button? start AP mode.
 	// @ ca 15s, or 3s after first start
 	digitalWrite(NOTIFY_PIN, HIGH); // power up
+	mqtt_disconnect(); // the setup page's test connects on its own
 	bool res = enable_ap_mode(&g_wifi_settings);
 	if (res) run_ap_mode(&g_wifi_settings);
 	// reboots afterwards
@@ -216,6 +398,9 @@ void loop() {
 	#endif
 
 	DEBUG_LOG("ESP.restart() ...");
+	#ifdef DEBUG_SERIAL_LATER
+	log_ring_drain();
+	#endif
 	ESP.restart(); ESP.reset();
 	DEBUG_LOG("... Restart & reset failed ... let's sleep");
 	ESP.deepSleep(30e6);
@@ -223,6 +408,21 @@ void loop() {
 }
 
 
+/* Collects values for placeholders in mqtt_value & rest_url; {ms} is
+ * updated by the caller right before rendering.
+ */
+void fill_template_context(TEMPLATE_CONTEXT_T *ctx) {
+	ctx->rssi = WiFi.RSSI();
+	ctx->ms = 0;
+	ctx->seq = g_wifi_settings.press_seq;
+	WiFi.macAddress(ctx->mac);
+	ctx->ip = WiFi.localIP();
+	// ADC read is slow-ish, only do it if needed
+	ctx->vcc = (g_wifi_settings.tpl_flags & TPL_USES(TPL_OP_VCC))?ESP.getVcc():0;
+	ctx->channel = WiFi.channel();
+}
+
+
 /* Show some debugging information --------------------------------- */
 /* ----------------------------------------------------------------- */
 
@@ -29,16 +29,48 @@
 //#define DEBUG_AP_MODE
 //#define DEBUG_SKIP_MQTT
 //#define DEBUG_SKIP_REST
+//#define DEBUG_BENCHMARK // only runs benchmarks, output on Serial
+//#define BENCH_FLASH_WRITES // with DEBUG_BENCHMARK: also time saves, wearing both settings slots
+//#define DEBUG_LOG_RING // with DEBUG_MODE: DEBUG_LOG is buffered, printed after the press
+//#define DEBUG_LOG_UDP_HOST "192.168.1.10" // also send the buffered log here, see log_ring.h
+
+// features; 0 leaves the code out of the build, see the profiles in platformio.ini
+#ifndef FEATURE_MQTT
+#define FEATURE_MQTT 1 // publish over MQTT, incl. autodiscovery & remote configuration
+#endif
+#ifndef FEATURE_REST
+#define FEATURE_REST 1 // request the REST URL with HTTPClient
+#endif
+#if !FEATURE_MQTT && !FEATURE_REST
+#error "Needs at least one of FEATURE_MQTT & FEATURE_REST"
+#endif
+//#define BAKED_CONFIG // settings from src/baked_config.h, see tools/bake_config.py
 
 // pin definitions for hardware
 #define LED_PIN 2
 #define NOTIFY_PIN 3
 
-// Macro to display a debug text + timing
-#ifdef DEBUG_MODE
+// LED blinking after a good press, see loop(); the energy estimate uses it too
+#define BLINK_MS 1500
+#define BLINK_STEP_MS 100 // on, off, on, ...
+
+// ordinary presses change the statistics in the settings only 1 in N times,
+// counted N times then, so most presses need no flash write
+#define STATS_SAMPLE_ONE_IN 8
+
+// Macros to display a debug text + timing, DEBUG_LOG1 also a number
+#if defined(DEBUG_MODE) && defined(DEBUG_LOG_RING)
+#include "log_ring.h"
+#define DEBUG_LOG(x) log_ring_add(PSTR(x), LOG_RING_NO_ARG)
+#define DEBUG_LOG1(x, v) log_ring_add(PSTR(x), (int32_t)(v))
+#define DEBUG_SERIAL_LATER // slow Serial output waits until after the press
+#elif defined(DEBUG_MODE)
 #define DEBUG_LOG(x) Serial.print(F(x)); Serial.print(F(" @ ")); Serial.println(millis())
+#define DEBUG_LOG1(x, v) Serial.print(F(x)); Serial.print(F(" @ ")); Serial.print(millis()); \
+	Serial.print(F(" = ")); Serial.println((int32_t)(v))
 #else
 #define DEBUG_LOG(x)
+#define DEBUG_LOG1(x, v)
 #endif
 
 #endif
@@ -0,0 +1,87 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* mdns_helper.cpp */
+
+/* Resolves "name.local" with a single multicast DNS query, sent from a
+ * normal UDP port. Responders answer these "legacy" queries directly to
+ * that port (RFC 6762, section 6.7), so we don't need to join the
+ * multicast group or run a full mDNS stack. There's no cache here: the
+ * device is off between presses, and the address found is kept in the
+ * settings (mqtt_host_ip, direct_ip) until the wifi cache is rebuilt.
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "main.h"
+#include "mdns_helper.h"
+#include "mdns_packet.h"
+
+#define MDNS_PORT 5353
+#define MDNS_LOCAL_PORT 5354 // any port other than 5353
+
+
+/* Returns true for names ending in ".local"
+ */
+bool mdns_is_local_name(const char *name) {
+	int len = strlen(name);
+	return (len>6) && !strcasecmp(name+len-6, ".local");
+}
+
+
+/* Look up name.local, returns true if found.
+ */
+bool mdns_resolve(const char *name, uint32_t *ip, uint32_t timeout_ms) {
+	DEBUG_LOG("mdns_resolve()");
+
+	uint8_t buf[256];
+	uint16_t id = (uint16_t)ESP.random();
+	int len = mdns_build_query(buf, sizeof(buf), id, name);
+	if (!len) return false;
+
+	WiFiUDP udp;
+	if (!udp.begin(MDNS_LOCAL_PORT)) return false;
+	bool found = false;
+	uint32_t start = millis();
+	uint32_t resend = start;
+	while (!found && (millis()-start < timeout_ms)) {
+		if ((int32_t)(millis() - resend) >= 0) { // resend a few times, UDP may get lost
+			udp.beginPacket(IPAddress(224, 0, 0, 251), MDNS_PORT);
+			udp.write(buf, len);
+			udp.endPacket();
+			resend = millis() + timeout_ms/4;
+		}
+		if (udp.parsePacket()) {
+			uint8_t resp[512];
+			int resp_len = udp.read(resp, sizeof(resp));
+			found = mdns_parse_answer(resp, resp_len, id, name, ip);
+		} else {
+			delay(2);
+		}
+	}
+	udp.stop();
+	if (!found) {
+		DEBUG_LOG("mdns_resolve(): no answer");
+		return false;
+	}
+	return true;
+}
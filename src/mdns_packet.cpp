@@ -0,0 +1,124 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* mdns_packet.cpp */
+
+/* Only plain C here, no Arduino, so the native tests in test/ can feed
+ * the parser captured responses.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "mdns_packet.h"
+
+
+/* Build a DNS query for the A record of name, returns length or 0
+ */
+int mdns_build_query(uint8_t *buf, int size, uint16_t id, const char *name) {
+	if (size < 12 + (int)strlen(name) + 2 + 4) return 0;
+	memset(buf, 0, 12);
+	buf[0] = id >> 8; buf[1] = id & 0xff;
+	buf[5] = 1; // 1 question
+	int pos = 12;
+	const char *label = name;
+	while (*label) {
+		const char *dot = strchr(label, '.');
+		int len = dot?(dot-label):strlen(label);
+		if (len<1 || len>63) return 0;
+		buf[pos++] = len;
+		memcpy(buf+pos, label, len); pos += len;
+		label += len + (dot?1:0);
+	}
+	buf[pos++] = 0;
+	buf[pos++] = 0; buf[pos++] = DNS_TYPE_A;
+	buf[pos++] = 0; buf[pos++] = DNS_CLASS_IN;
+	return pos;
+}
+
+
+/* Compare a (possibly compressed) name in a DNS packet with a dotted
+ * name. Sets *next to the position after the name. Returns true if equal.
+ */
+static bool _match_name(const uint8_t *buf, int len, int pos, const char *name, int *next) {
+	const char *cmp = name;
+	bool match = true;
+	bool jumped = false;
+	int jumps = 0;
+	while (pos<len) {
+		uint8_t l = buf[pos];
+		if ((l & 0xc0) == 0xc0) { // compression pointer
+			if (pos+1>=len || ++jumps>10) return false;
+			if (!jumped) *next = pos + 2;
+			jumped = true;
+			pos = ((l & 0x3f) << 8) | buf[pos+1];
+			continue;
+		}
+		pos++;
+		if (!l) {
+			if (!jumped) *next = pos;
+			return match && !*cmp;
+		}
+		if (pos+l>len) return false;
+		if (cmp!=name) {
+			if (*cmp=='.') cmp++; else match = false;
+		}
+		if (match && !strncasecmp(cmp, (const char *)buf+pos, l) && (strlen(cmp)>=l)) {
+			cmp += l;
+		} else {
+			match = false;
+		}
+		pos += l;
+	}
+	return false;
+}
+
+
+/* Find the A record for name in a response, returns true if found; the
+ * TTL is skipped, a button is off between presses & can't age the address
+ */
+bool mdns_parse_answer(const uint8_t *buf, int len, uint16_t id, const char *name, uint32_t *ip) {
+	if (len<12) return false;
+	if (((buf[0]<<8) | buf[1]) != id) return false;
+	if (!(buf[2] & 0x80)) return false; // not a response
+	int questions = (buf[4]<<8) | buf[5];
+	int answers = ((buf[6]<<8) | buf[7]) + ((buf[8]<<8) | buf[9]) + ((buf[10]<<8) | buf[11]);
+	int pos = 12;
+	for (int i=0; i<questions; i++) {
+		_match_name(buf, len, pos, name, &pos);
+		pos += 4; // type, class
+	}
+	for (int i=0; i<answers && pos<len; i++) {
+		bool match = _match_name(buf, len, pos, name, &pos);
+		if (pos+10>len) return false;
+		uint16_t type = (buf[pos]<<8) | buf[pos+1];
+		uint16_t cls = ((buf[pos+2]<<8) | buf[pos+3]) & 0x7fff; // without cache-flush bit
+		uint16_t rdlen = (buf[pos+8]<<8) | buf[pos+9]; // after the TTL
+		pos += 10;
+		if (pos+rdlen>len) return false;
+		if (match && type==DNS_TYPE_A && cls==DNS_CLASS_IN && rdlen==4) {
+			memcpy(ip, buf+pos, 4); // stays in network order, like IPAddress
+			return true;
+		}
+		pos += rdlen;
+	}
+	return false;
+}
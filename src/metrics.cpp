@@ -0,0 +1,123 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* metrics.cpp */
+
+/* Sends everything we know about a press as one UDP datagram, in the
+ * InfluxDB line protocol, e.g.
+ *
+ *   press,device=button1,path=fast,strategy=bssid ok=1i,total_ms=412i,wifi_ms=231i,...
+ *
+ * It's sent at the end of setup(), after the MQTT publish & REST call,
+ * and never waits for an answer. Phase times come from the boot trace,
+ * the energy_*_uah fields from energy.cpp.
+ * tools/metrics_receiver.py collects them & shows percentiles.
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <user_interface.h>
+
+#include "main.h"
+#include "settings.h"
+#include "metrics.h"
+#include "boot_trace.h"
+#include "strategy.h"
+#include "mqtt_helper.h"
+#include "rf_cal.h"
+#include "energy.h"
+
+extern unsigned long g_start_millis;
+extern unsigned long g_boot_millis;
+
+
+/* Copy a tag value, escaping what the line protocol needs escaped */
+static void _escape_tag(char *dest, int size, const char *input) {
+	int len = 0;
+	for (; *input && len < size-2; input++) {
+		if (*input==' ' || *input==',' || *input=='=') dest[len++] = '\\';
+		dest[len++] = *input;
+	}
+	dest[len] = 0;
+}
+
+
+/* Append ",name=<ms>i" for the time between two traced events, if both
+ * were seen; returns the new length.
+ */
+static int _add_phase(char *buf, int len, int size, const char *name,
+		uint8_t from_event, uint8_t to_event) {
+	TRACE_ENTRY_T *from = trace_find(from_event);
+	TRACE_ENTRY_T *to = trace_find(to_event);
+	if (!from || !to || len >= size) return len;
+	return len + snprintf(buf+len, size-len, ",%s=%lui", name,
+		(unsigned long)(to->ms - from->ms));
+}
+
+
+/* Send the metrics for this press, if a collector is set up */
+bool metrics_send(WIFI_SETTINGS_T *data, bool fast_path, bool ok) {
+	if (!data->metrics_ip) return false;
+	DEBUG_LOG("metrics_send()");
+	char device[60];
+	char buf[640];
+	_escape_tag(device, sizeof(device), data->mqtt_client_id);
+
+	int len = snprintf(buf, sizeof(buf), "press,device=%s,path=%s,strategy=%s ok=%ii,total_ms=%lui",
+		device, fast_path?"fast":"slow", strategy_name(strategy_last()), ok?1:0,
+		(unsigned long)(millis() - g_start_millis));
+	len = _add_phase(buf, len, sizeof(buf), "wifi_ms", TRACE_SETUP_START, TRACE_WIFI_CONNECTED);
+	len = _add_phase(buf, len, sizeof(buf), "direct_ms", TRACE_WIFI_CONNECTED, TRACE_DIRECT_DONE);
+	len = _add_phase(buf, len, sizeof(buf), "mqtt_ms", TRACE_WIFI_CONNECTED, TRACE_MQTT_CONNECTED);
+	len = _add_phase(buf, len, sizeof(buf), "publish_ms", TRACE_MQTT_CONNECTED, TRACE_MQTT_PUBLISHED);
+	len = _add_phase(buf, len, sizeof(buf), "actions_ms", TRACE_MQTT_PUBLISHED, TRACE_ACTIONS_DONE);
+	len = _add_phase(buf, len, sizeof(buf), "rest_ms", TRACE_MQTT_PUBLISHED, TRACE_REST_DONE);
+	TRACE_ENTRY_T *direct = trace_find(TRACE_DIRECT_DONE);
+	if (direct && (len < (int)sizeof(buf))) {
+		len += snprintf(buf+len, sizeof(buf)-len, ",direct_ok=%lui", (unsigned long)direct->value);
+	}
+	if (len < (int)sizeof(buf)) {
+		len += snprintf(buf+len, sizeof(buf)-len,
+			",boot_ms=%lui,full_cal=%ii,rssi=%lii,channel=%lii,mqtt_tries=%ui"
+			",fail_streak=%ui,heap=%lui,boot_reason=%lui,seq=%lui",
+			g_boot_millis, rf_cal_was_full()?1:0, (long)WiFi.RSSI(), (long)WiFi.channel(),
+			mqtt_tcp_tries(), data->connect_fail_streak, (unsigned long)ESP.getFreeHeap(),
+			(unsigned long)system_get_rst_info()->reason, (unsigned long)data->press_seq);
+	}
+	// estimated charge, incl. the blinking that follows a good press
+	ENERGY_T energy;
+	energy_estimate(&energy, ok);
+	for (int i=0; i<ENERGY_PHASE_COUNT && len<(int)sizeof(buf); i++) {
+		len += snprintf(buf+len, sizeof(buf)-len, ",energy_%s_uah=%lu.%lu", energy_phase_name(i),
+			(unsigned long)(energy.phase[i]/10), (unsigned long)(energy.phase[i]%10));
+	}
+	if (len < (int)sizeof(buf)) {
+		len += snprintf(buf+len, sizeof(buf)-len, ",energy_uah=%lu.%lu",
+			(unsigned long)(energy.total/10), (unsigned long)(energy.total%10));
+	}
+	if (len >= (int)sizeof(buf)) return false;
+
+	WiFiUDP udp;
+	if (!udp.beginPacket(IPAddress(data->metrics_ip),
+			data->metrics_port?data->metrics_port:METRICS_DEFAULT_PORT)) return false;
+	udp.write((const uint8_t *)buf, len);
+	return udp.endPacket();
+}
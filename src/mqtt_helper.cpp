@@ -22,15 +22,33 @@
 
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
-#include <PubSubClient.h>
 
 #include "main.h"
+#if FEATURE_MQTT
+#include <PubSubClient.h>
+#endif
 #include "settings.h"
 #include "wifi_helper.h"
+#include "mqtt_helper.h"
+#include "text_escape.h"
+#include "template_helper.h"
+#include "action_helper.h"
+#include "strategy.h"
+#include "rf_cal.h"
+#include "latency_hist.h"
+
+#if FEATURE_MQTT
 
 bool g_mqtt_connected;
 PubSubClient g_mqtt_client;
+static uint32_t _tcp_connect_ms; // last pre-connect, see mqtt_tcp_connect_ms()
+static uint16_t _tcp_tries; // connect() calls for it
+static const char *_fetch_topic; // see mqtt_fetch_retained()
+static char *_fetch_buf;
+static int _fetch_size;
+static int _fetch_len;
 extern unsigned long g_start_millis;
+extern unsigned long g_boot_millis;
 
 
 /* MQTT  ----------------------------------------------------------- */
@@ -39,7 +57,7 @@ extern unsigned long g_start_millis;
 
 /* Try to connect to MQTT server, if needed
  */
-bool mqtt_connect_server(WiFiClient *wclient, WIFI_SETTINGS_T *data) {
+bool mqtt_connect_server(WiFiClient *wclient, WIFI_SETTINGS_T *data, uint32_t timeout_ms) {
 	DEBUG_LOG("mqtt_connect_server()");
 	if (g_mqtt_connected) return true;
 	if (!data->mqtt_host_ip) {
@@ -47,22 +65,33 @@ bool mqtt_connect_server(WiFiClient *wclient, WIFI_SETTINGS_T *data) {
 		return false; // no MQTT hostname
 	}
 
-	// Pre-connect to IP address
-	#define PRECONNECT_TIMEOUT 5000
-	uint32_t timeout = millis() + PRECONNECT_TIMEOUT;
-	while ((!wclient->connect(data->mqtt_host_ip, data->mqtt_host_port))
-			&& (millis()<timeout)) { delay(50); }
+	// Pre-connect to IP address; each attempt only gets the time left
+	uint32_t start = millis();
+	uint32_t timeout = start + timeout_ms;
+	_tcp_tries = 0;
+	while (true) {
+		uint32_t left = ((int32_t)(timeout - millis()) > 0)?(timeout - millis()):0;
+		if (_tcp_tries && (left < MQTT_CONNECT_MIN_MS)) break;
+		wclient->setTimeout(left);
+		_tcp_tries++;
+		if (wclient->connect(data->mqtt_host_ip, data->mqtt_host_port)) break;
+		delay(50);
+	}
 	if (!wclient->connected()) {
 		DEBUG_LOG("Connect to MQTT IP-address FAILED");
 		return false; // can't connect to IP
 	}
+	_tcp_connect_ms = millis() - start;
 
 	// Do full connection to MQTT
 	g_mqtt_client.setClient(*wclient);
 	g_mqtt_client.setServer(data->mqtt_host_ip, data->mqtt_host_port);
+	// CONNACK wait, in seconds; PubSubClient's default is 15
+	uint32_t left = (int32_t)(timeout - millis()) > 0 ? timeout - millis() : 0;
+	g_mqtt_client.setSocketTimeout((left < 1000)?1:left/1000);
 
 	if (!g_mqtt_client.connect(data->mqtt_client_id, data->mqtt_user, data->mqtt_auth)) {
-		DEBUG_LOG("MQTT.connect() FAILED");
+		DEBUG_LOG1("MQTT.connect() FAILED, state", g_mqtt_client.state());
 		return false;
 	}
 	g_mqtt_connected = true;
@@ -72,47 +101,37 @@ bool mqtt_connect_server(WiFiClient *wclient, WIFI_SETTINGS_T *data) {
 
 /* Publish a topic to MQTT, if connected
  */
-bool mqtt_send_topic(char *topic, char *value) {
+bool mqtt_send_topic(char *topic, char *value, bool retain) {
 	DEBUG_LOG("mqtt_send_topic()");
 	if (!g_mqtt_connected) {
 		DEBUG_LOG("mqtt_send_topic() FAILED, no connection");
 		return false; // needs connection
 	}
-	#ifdef DEBUG_MODE
+	#if defined(DEBUG_MODE) && !defined(DEBUG_SERIAL_LATER)
 	char buf_debug[200];
 	snprintf(buf_debug, sizeof(buf_debug), "  Topic '%s' = '%s'", topic, value);
 	Serial.println(buf_debug);
 	#endif
-	return g_mqtt_client.publish(topic, value);
+	return g_mqtt_client.publish(topic, value, retain);
 }
 
 
-/* Escape this string as a JSON value
- *   Backspace -> \b
- *   Form feed -> \f
- *   Newline -> \n
- *   Carriage return -> \r
- *   Tab -> \t
- *   Double quote -> \"
- *   Backslash -> \\
+/* Render a compiled template & publish it to MQTT, if connected
  */
-void _escape_json_value(char *dest, int size, char *input) {
-	char *in_ptr = input;
-	char *out_ptr = dest;
-	while (*in_ptr) {
-		if (strchr("\"\\\b\f\n\r\t", *in_ptr) != NULL) {
-			*out_ptr = '\\'; out_ptr++;
-		}
-		*out_ptr = *in_ptr;
-		if (*out_ptr=='\b') *out_ptr='b'; // special cases
-		if (*out_ptr=='\f') *out_ptr='f';
-		if (*out_ptr=='\n') *out_ptr='n';
-		if (*out_ptr=='\r') *out_ptr='r';
-		if (*out_ptr=='\t') *out_ptr='t';
-		out_ptr++; in_ptr++;
-		if (out_ptr - dest>size-2) break;
+bool mqtt_send_template(char *topic, uint8_t *tpl, TEMPLATE_CONTEXT_T *ctx) {
+	DEBUG_LOG("mqtt_send_template()");
+	if (!g_mqtt_connected) {
+		DEBUG_LOG("mqtt_send_template() FAILED, no connection");
+		return false; // needs connection
 	}
-	*out_ptr=0;
+	char buf_value[200];
+	int len = template_render(buf_value, sizeof(buf_value), tpl, ctx);
+	#if defined(DEBUG_MODE) && !defined(DEBUG_SERIAL_LATER)
+	char buf_debug[300];
+	snprintf(buf_debug, sizeof(buf_debug), "  Topic '%s' = '%s'", topic, buf_value);
+	Serial.println(buf_debug);
+	#endif
+	return g_mqtt_client.publish(topic, (uint8_t *)buf_value, len);
 }
 
 
@@ -128,9 +147,9 @@ bool mqtt_send_autodiscover(WIFI_SETTINGS_T *data) {
 	data->mqtt_client_id);
 
 	char state_topic_safe[100];
-	_escape_json_value(state_topic_safe, sizeof(state_topic_safe), state_topic);
+	escape_json_value(state_topic_safe, sizeof(state_topic_safe), state_topic);
 	char client_id_safe[50];
-	_escape_json_value(client_id_safe, sizeof(client_id_safe), data->mqtt_client_id);
+	escape_json_value(client_id_safe, sizeof(client_id_safe), data->mqtt_client_id);
 
 	snprintf(buf_value, sizeof(buf_value),
 		"{\"stat_t\":\"%s\",\"name\":\"%s\",\"off_delay\":30,\"dev\":{"
@@ -179,10 +198,110 @@ bool mqtt_send_device_state(WIFI_SETTINGS_T *data) {
 
 	snprintf(buf_topic, sizeof(buf_topic), "softplus/%s/time_connect", data->mqtt_client_id);
 	snprintf(buf_value, sizeof(buf_value), "%lu", millis()-g_start_millis);
+	result = mqtt_send_topic(buf_topic, buf_value);
+	if (!result) return false;
+
+	// time before setup(), incl. RF calibration; "ms,1" if full calibration
+	snprintf(buf_topic, sizeof(buf_topic), "softplus/%s/time_boot", data->mqtt_client_id);
+	snprintf(buf_value, sizeof(buf_value), "%lu,%i", g_boot_millis, rf_cal_was_full()?1:0);
+	result = mqtt_send_topic(buf_topic, buf_value);
+	if (!result) return false;
+
+	// connect strategy used & its result, see strategy.h
+	snprintf(buf_topic, sizeof(buf_topic), "softplus/%s/strategy", data->mqtt_client_id);
+	strategy_format_last(buf_value, sizeof(buf_value));
+	result = mqtt_send_topic(buf_topic, buf_value);
+	if (!result) return false;
+
+	// per-action latency in ms, "-1" for failed actions, empty ones skipped
+	int len = 0;
+	buf_value[0] = 0;
+	for (int i=0; i<MAX_ACTIONS; i++) {
+		if (data->actions[i].type == ACTION_NONE) continue;
+		len += snprintf(buf_value+len, sizeof(buf_value)-len, "%s%i",
+			len?",":"", actions_latency(i));
+	}
+	if (!len) return true;
+	snprintf(buf_topic, sizeof(buf_topic), "softplus/%s/time_actions", data->mqtt_client_id);
 	return mqtt_send_topic(buf_topic, buf_value);
 }
 
 
+/* Send the latency summary, retained, so it can be read any time
+ */
+bool mqtt_send_latency_summary(WIFI_SETTINGS_T *data) {
+	DEBUG_LOG("mqtt_send_latency_summary()");
+	char buf_topic[200], buf_value[200];
+
+	snprintf(buf_topic, sizeof(buf_topic), "softplus/%s/latency", data->mqtt_client_id);
+	hist_format_summary(buf_value, sizeof(buf_value), data);
+	return mqtt_send_topic(buf_topic, buf_value, true);
+}
+
+
+/* Send how many presses before this one couldn't be delivered, see
+ * missed_presses
+ */
+bool mqtt_send_missed_presses(WIFI_SETTINGS_T *data) {
+	DEBUG_LOG("mqtt_send_missed_presses()");
+	char buf_topic[200], buf_value[12];
+
+	snprintf(buf_topic, sizeof(buf_topic), "softplus/%s/missed", data->mqtt_client_id);
+	snprintf(buf_value, sizeof(buf_value), "%u", data->missed_presses);
+	return mqtt_send_topic(buf_topic, buf_value);
+}
+
+
+/* Keeps the message mqtt_fetch_retained() waits for */
+static void _fetch_callback(char *topic, uint8_t *payload, unsigned int len) {
+	if (!_fetch_buf || strcmp(topic, _fetch_topic)) return;
+	if ((int)len >= _fetch_size) { _fetch_len = -2; return; } // too long
+	memcpy(_fetch_buf, payload, len);
+	_fetch_buf[len] = 0;
+	_fetch_len = len;
+}
+
+
+/* Get the retained message of a topic: subscribe, wait for it, and
+ * unsubscribe. Returns its length, or -1 if there's none (yet), it
+ * didn't fit into buf, or we're not connected.
+ */
+int mqtt_fetch_retained(const char *topic, char *buf, int size, uint32_t timeout_ms) {
+	DEBUG_LOG("mqtt_fetch_retained()");
+	if (!g_mqtt_connected) return -1;
+	// incoming messages must fit into PubSubClient's buffer too
+	uint16_t needed = size + strlen(topic) + 8;
+	if (g_mqtt_client.getBufferSize() < needed) g_mqtt_client.setBufferSize(needed);
+	_fetch_topic = topic;
+	_fetch_buf = buf;
+	_fetch_size = size;
+	_fetch_len = -1;
+	g_mqtt_client.setCallback(_fetch_callback);
+	if (g_mqtt_client.subscribe(topic)) {
+		uint32_t start = millis();
+		while ((_fetch_len == -1) && (millis() - start < timeout_ms)
+				&& g_mqtt_client.loop()) {
+			delay(5);
+		}
+		g_mqtt_client.unsubscribe(topic);
+	}
+	_fetch_buf = NULL;
+	return (_fetch_len >= 0)?_fetch_len:-1;
+}
+
+
+/* Time the last TCP connect to the MQTT server took, in ms */
+uint32_t mqtt_tcp_connect_ms() {
+	return _tcp_connect_ms;
+}
+
+
+/* Number of TCP connect attempts for the last MQTT connect */
+uint16_t mqtt_tcp_tries() {
+	return _tcp_tries;
+}
+
+
 /* Disconnect from MQTT server, if connected
  */
 void mqtt_disconnect() {
@@ -193,3 +312,21 @@ void mqtt_disconnect() {
 		g_mqtt_connected = false;
 	}
 }
+
+#else // !FEATURE_MQTT
+
+/* Without MQTT, nothing connects & nothing gets published */
+bool mqtt_connect_server(WiFiClient *wclient, WIFI_SETTINGS_T *data, uint32_t timeout_ms) { return false; }
+bool mqtt_send_topic(char *topic, char *value, bool retain) { return false; }
+bool mqtt_send_template(char *topic, uint8_t *tpl, TEMPLATE_CONTEXT_T *ctx) { return false; }
+bool mqtt_send_autodiscover(WIFI_SETTINGS_T *data) { return false; }
+bool mqtt_send_network_info(ESP8266WiFiClass *w, WIFI_SETTINGS_T *data) { return false; }
+bool mqtt_send_device_state(WIFI_SETTINGS_T *data) { return false; }
+bool mqtt_send_latency_summary(WIFI_SETTINGS_T *data) { return false; }
+bool mqtt_send_missed_presses(WIFI_SETTINGS_T *data) { return false; }
+int mqtt_fetch_retained(const char *topic, char *buf, int size, uint32_t timeout_ms) { return -1; }
+uint32_t mqtt_tcp_connect_ms() { return 0; }
+uint16_t mqtt_tcp_tries() { return 0; }
+void mqtt_disconnect() {}
+
+#endif
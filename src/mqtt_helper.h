@@ -24,13 +24,23 @@
 #define MQTT_HELPER_H
 
 #include "settings.h"
+#include "template_helper.h"
 #include <ESP8266WiFi.h>
 
-bool mqtt_connect_server(WiFiClient *wclient, WIFI_SETTINGS_T *data);
-bool mqtt_send_topic(char *topic, char *value);
+#define PRECONNECT_TIMEOUT 5000 // ms
+#define MQTT_CONNECT_MIN_MS 100 // no new connect() attempt with less time left
+
+bool mqtt_connect_server(WiFiClient *wclient, WIFI_SETTINGS_T *data, uint32_t timeout_ms=PRECONNECT_TIMEOUT);
+bool mqtt_send_topic(char *topic, char *value, bool retain=false);
+bool mqtt_send_template(char *topic, uint8_t *tpl, TEMPLATE_CONTEXT_T *ctx);
 bool mqtt_send_autodiscover(WIFI_SETTINGS_T *data);
 bool mqtt_send_network_info(ESP8266WiFiClass *w, WIFI_SETTINGS_T *data);
 bool mqtt_send_device_state(WIFI_SETTINGS_T *data);
+bool mqtt_send_latency_summary(WIFI_SETTINGS_T *data);
+bool mqtt_send_missed_presses(WIFI_SETTINGS_T *data);
+int mqtt_fetch_retained(const char *topic, char *buf, int size, uint32_t timeout_ms);
+uint32_t mqtt_tcp_connect_ms();
+uint16_t mqtt_tcp_tries();
 void mqtt_disconnect();
 
 #endif
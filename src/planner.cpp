@@ -0,0 +1,100 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* planner.cpp */
+
+/* Each phase gets the time it would normally use (its old fixed timeout),
+ * but never more than what's left of the press deadline after keeping
+ * enough for the phases that must still follow. If that's less than the
+ * phase needs to have a chance at all, it gets 0 and the caller gives up
+ * right away instead of running into the deadline. Decisions are logged
+ * to the boot trace as TRACE_PLAN_* events, value = budget in ms.
+ * Without a deadline in the settings, the deadline is the sum of all
+ * phase timeouts, so each phase keeps its full timeout as before. A press
+ * that couldn't be delivered in time is counted in missed_presses and
+ * reported with the next good one, see setup().
+ */
+
+#include <Arduino.h>
+
+#include "main.h"
+#include "planner.h"
+#include "boot_trace.h"
+#include "wifi_helper.h"
+#include "mqtt_helper.h"
+#include "action_helper.h"
+#include "direct_trigger.h"
+
+#define REST_TIMEOUT 5000 // ms, HTTPClient's default
+
+struct PLAN_PHASE_INFO_T {
+	uint16_t min_ms; // less than this can't work
+	uint16_t max_ms; // never more than this
+	uint16_t reserve_ms; // keep for the phases after this one
+};
+
+static const PLAN_PHASE_INFO_T _phases[PLAN_PHASE_COUNT] = {
+	{  300, FAST_TIMEOUT, 2500 + 100 }, // leave room for slow connect + MQTT
+	{ 2500, SLOW_TIMEOUT, 100 }, // scan, associate, DHCP; then MQTT
+	{  100, DIRECT_TIMEOUT, 100 }, // leave room for MQTT
+	{  100, PRECONNECT_TIMEOUT, 0 },
+	{  100, HTTP_ACTION_TIMEOUT, 0 },
+	{  200, REST_TIMEOUT, 0 }
+};
+
+static uint32_t _start;
+static uint32_t _deadline;
+
+
+/* Start planning, deadline_ms after start_millis; 0 = no deadline of
+ * its own, every phase may use its full timeout
+ */
+void planner_begin(uint32_t start_millis, uint32_t deadline_ms) {
+	_start = start_millis;
+	if (!deadline_ms) {
+		for (int i=0; i<PLAN_PHASE_COUNT; i++) deadline_ms += _phases[i].max_ms;
+	}
+	_deadline = deadline_ms;
+}
+
+
+/* Time left until the deadline, in ms
+ */
+uint32_t planner_remaining() {
+	uint32_t used = millis() - _start;
+	return (used < _deadline)?(_deadline - used):0;
+}
+
+
+/* Time the phase may take, in ms. 0 means: skip it, it can't succeed.
+ */
+uint32_t planner_budget(uint8_t phase) {
+	if (phase >= PLAN_PHASE_COUNT) return 0;
+	const PLAN_PHASE_INFO_T *info = &_phases[phase];
+	uint32_t remaining = planner_remaining();
+	uint32_t budget = (remaining > info->reserve_ms)?(remaining - info->reserve_ms):0;
+	if (budget > info->max_ms) budget = info->max_ms;
+	if (budget < info->min_ms) {
+		DEBUG_LOG1("planner_budget(): out of time, skipping phase", phase);
+		budget = 0;
+	}
+	trace_sample(TRACE_PLAN_WIFI_FAST + phase, budget);
+	return budget;
+}
@@ -0,0 +1,42 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* planner.h - splits one deadline per press over the connection phases */
+
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stdint.h>
+
+enum PLAN_PHASE_T : uint8_t {
+	PLAN_WIFI_FAST,
+	PLAN_WIFI_SLOW,
+	PLAN_DIRECT,
+	PLAN_MQTT,
+	PLAN_ACTIONS,
+	PLAN_REST,
+	PLAN_PHASE_COUNT
+};
+
+void planner_begin(uint32_t start_millis, uint32_t deadline_ms);
+uint32_t planner_budget(uint8_t phase);
+uint32_t planner_remaining();
+
+#endif
@@ -0,0 +1,85 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* rf_cal.cpp */
+
+/* A full RF calibration at power-on takes around 200 ms, before setup()
+ * even starts. The result is kept in flash by the SDK, so on most boots we
+ * only do the quick VDD33 calibration and reuse it. A full calibration is
+ * done about every RF_CAL_INTERVAL boots, and after RF_CAL_MAX_FAILS failed
+ * connects in a row, in case the old calibration is the problem.
+ */
+
+#include <Arduino.h>
+#include <user_interface.h>
+#include <stddef.h>
+
+#include "main.h"
+#include "settings.h"
+#include "rf_cal.h"
+
+#define RF_POWERUP_VDD33_CAL 2 // system_phy_set_powerup_option() values
+#define RF_POWERUP_FULL_CAL 3
+
+static bool _full_cal = true;
+static uint32_t _pre_init_us;
+
+
+/* Called by the core before the RF is initialized
+ */
+RF_PRE_INIT() {
+	_pre_init_us = system_get_time();
+	uint8_t state[2]; // rf_cal_countdown, connect_fail_streak
+	_full_cal = !peek_settings_in_flash(offsetof(WIFI_SETTINGS_T, rf_cal_countdown),
+			state, sizeof(state))
+		|| !state[0] || (state[1] >= RF_CAL_MAX_FAILS);
+	system_phy_set_powerup_option(_full_cal?RF_POWERUP_FULL_CAL:RF_POWERUP_VDD33_CAL);
+}
+
+
+/* Whether this boot did a full RF calibration */
+bool rf_cal_was_full() {
+	return _full_cal;
+}
+
+
+/* Time from power-on to RF init, in ms */
+uint32_t rf_cal_pre_init_ms() {
+	return _pre_init_us / 1000;
+}
+
+
+/* Update the calibration counters after connecting, returns true if
+ * the settings changed & need to be saved. The countdown only moves on
+ * presses sampled for statistics, by their weight.
+ */
+bool rf_cal_update(WIFI_SETTINGS_T *data, bool connected, uint8_t weight) {
+	uint8_t countdown = data->rf_cal_countdown;
+	uint8_t fails = data->connect_fail_streak;
+	if (connected) {
+		data->connect_fail_streak = 0;
+		if (_full_cal) data->rf_cal_countdown = RF_CAL_INTERVAL;
+		else if (data->rf_cal_countdown > weight) data->rf_cal_countdown -= weight;
+		else if (weight) data->rf_cal_countdown = 0;
+	} else if (data->connect_fail_streak < 255) {
+		data->connect_fail_streak++;
+	}
+	return (countdown != data->rf_cal_countdown) || (fails != data->connect_fail_streak);
+}
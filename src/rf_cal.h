@@ -0,0 +1,35 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* rf_cal.h - decides on RF calibration before setup() runs */
+
+#ifndef RF_CAL_H
+#define RF_CAL_H
+
+#include "settings.h"
+
+#define RF_CAL_INTERVAL 20 // full calibration about every N boots, see rf_cal_update()
+#define RF_CAL_MAX_FAILS 2 // or after this many failed connects in a row
+
+bool rf_cal_was_full();
+uint32_t rf_cal_pre_init_ms();
+bool rf_cal_update(WIFI_SETTINGS_T *data, bool connected, uint8_t weight);
+
+#endif
@@ -22,44 +22,200 @@
 
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
-#include <EEPROM.h>
+#include <spi_flash.h>
+#include <coredecls.h> // crc32()
 
 #include "main.h"
 #include "settings.h"
+#include "template_helper.h"
+#include "mdns_helper.h"
+#include "action_helper.h"
+#ifdef BAKED_CONFIG
+#include "baked_config.h" // generated by tools/bake_config.py
+#endif
+
+extern "C" uint32_t _EEPROM_start; // from the linker script
+extern "C" uint32_t _FS_start;
+extern "C" uint32_t _FS_end;
 
 /* Save & restore settings from Flash ------------------------------ */
 /* ----------------------------------------------------------------- */
 
+/* Settings are stored in two flash sectors, taking turns: slot 0 is the
+ * EEPROM sector, slot 1 the last sector of the (unused) file system area
+ * right before it. Each save goes to the slot not in use, and the footer
+ * goes last, so a save cut short by a power drop leaves the previous
+ * settings in place. platformio.ini pins a flash layout with such an area;
+ * without one, slot 0 is written in place.
+ */
+struct SETTINGS_FOOTER_T { // stored right after WIFI_SETTINGS_T
+	uint32_t seq; // counts up with each save; 0xffffffff = no footer
+	uint32_t crc; // of the settings & seq
+};
+
+#define SLOT_NONE -1
+#define SLOT_UNKNOWN -2
+#define SLOT_CRC_CHUNK 256
+
+static int8_t _slot = SLOT_UNKNOWN; // slot holding the current settings
+static uint32_t _slot_seq;
+
+
+/* Flash address of a settings slot */
+static uint32_t _slot_addr(int slot) {
+	uint32_t addr = (uint32_t)&_EEPROM_start - 0x40200000;
+	return slot ? addr - SPI_FLASH_SEC_SIZE : addr;
+}
+
 
-/* Saves our wifi settings structure to flash memory
- * using the EEPROM library.
+/* Whether the sector before the EEPROM one is free for slot 1 */
+static bool _slot_1_exists() {
+	uint32_t addr = (uint32_t)&_EEPROM_start - SPI_FLASH_SEC_SIZE;
+	return (addr >= (uint32_t)&_FS_start) && (addr < (uint32_t)&_FS_end);
+}
+
+
+/* Checks one slot straight from flash. Returns false if it's empty or
+ * damaged; a record from before the slots (in slot 0, without footer)
+ * is fine too, with seq 0, so any newer save wins over it.
+ */
+static bool _slot_check(int slot, uint32_t *seq) {
+	uint32_t addr = _slot_addr(slot);
+	uint32_t chunk[SLOT_CRC_CHUNK/4];
+	SETTINGS_FOOTER_T footer;
+	spi_flash_read(addr + sizeof(WIFI_SETTINGS_T), (uint32_t *)&footer, sizeof(footer));
+	spi_flash_read(addr, chunk, sizeof(uint32_t));
+	if ((chunk[0] & 0xffff) != SETTINGS_MAGIC_NUM) return false;
+	if ((footer.seq == 0xffffffff) && (footer.crc == 0xffffffff)) {
+		*seq = 0;
+		return (slot == 0);
+	}
+	uint32_t crc = 0xffffffff;
+	for (uint32_t pos=0; pos<sizeof(WIFI_SETTINGS_T); pos+=sizeof(chunk)) {
+		spi_flash_read(addr + pos, chunk, sizeof(chunk));
+		crc = crc32(chunk, sizeof(chunk), crc);
+	}
+	crc = crc32(&footer.seq, sizeof(footer.seq), crc);
+	*seq = footer.seq;
+	return (crc == footer.crc);
+}
+
+
+/* Finds the slot with the newest valid settings, once per boot; also
+ * works before setup(), e.g. in RF_PRE_INIT(). Returns SLOT_NONE if
+ * there are none.
+ */
+static int _settings_slot() {
+	if (_slot != SLOT_UNKNOWN) return _slot;
+	uint32_t seq0, seq1;
+	bool ok0 = _slot_check(0, &seq0);
+	bool ok1 = _slot_1_exists() && _slot_check(1, &seq1);
+	_slot = SLOT_NONE;
+	_slot_seq = 0;
+	if (ok0 && (!ok1 || (seq0 > seq1))) { _slot = 0; _slot_seq = seq0; }
+	else if (ok1) { _slot = 1; _slot_seq = seq1; }
+	return _slot;
+}
+
+
+/* Saves our wifi settings structure to flash memory, in the
+ * slot that's not in use.
  */
 void save_settings_to_flash(WIFI_SETTINGS_T *data) {
 	DEBUG_LOG("save_settings_to_flash()");
 
-	char buf[sizeof(*data)];
-	memcpy(&buf, data, sizeof(buf));
-	EEPROM.begin(sizeof(buf));
-	EEPROM.put(0, buf);
-	EEPROM.commit();
-	EEPROM.end();
+	static_assert(sizeof(WIFI_SETTINGS_T) % SLOT_CRC_CHUNK == 0, "settings must be whole CRC chunks");
+	static_assert(sizeof(WIFI_SETTINGS_T) + sizeof(SETTINGS_FOOTER_T) <= SPI_FLASH_SEC_SIZE,
+		"settings & footer must fit in one flash sector");
+	if (!_slot_1_exists()) {
+		DEBUG_LOG("  No file system area, writing in place");
+	}
+	int slot = (_slot_1_exists() && (_settings_slot() != 1)) ? 1 : 0;
+	SETTINGS_FOOTER_T footer;
+	footer.seq = _slot_seq + 1;
+	footer.crc = crc32(data, sizeof(*data));
+	footer.crc = crc32(&footer.seq, sizeof(footer.seq), footer.crc);
+
+	uint32_t addr = _slot_addr(slot);
+	noInterrupts();
+	bool ok = (spi_flash_erase_sector(addr / SPI_FLASH_SEC_SIZE) == SPI_FLASH_RESULT_OK)
+		&& (spi_flash_write(addr, (uint32_t *)data, sizeof(*data)) == SPI_FLASH_RESULT_OK)
+		&& (spi_flash_write(addr + sizeof(*data), (uint32_t *)&footer, sizeof(footer)) == SPI_FLASH_RESULT_OK);
+	interrupts();
+	if (ok) {
+		_slot = slot;
+		_slot_seq = footer.seq;
+	}
+	if (!ok) {
+		DEBUG_LOG("  Flash write failed");
+	}
 }
 
 
+/* Reads part of the stored settings straight from flash, so it also
+ * works before setup(), e.g. in RF_PRE_INIT().
+ * Returns false if there are no valid settings.
+ */
+bool peek_settings_in_flash(uint32_t offset, void *dest, uint32_t len) {
+	int slot = _settings_slot();
+	if (slot == SLOT_NONE) return false;
+	uint32_t base = _slot_addr(slot);
+	uint32_t word;
+	// flash reads must be 32-bit aligned
+	uint8_t *out = (uint8_t *)dest;
+	for (uint32_t pos=offset; pos<offset+len; pos++) {
+		if (pos==offset || !(pos & 3)) spi_flash_read(base + (pos & ~3), &word, sizeof(word));
+		*out++ = (word >> (8 * (pos & 3))) & 0xff;
+	}
+	return true;
+}
+
+
+#ifdef BAKED_CONFIG
+/* Baked builds: the editable settings always come from the image, and
+ * only the cache & statistics from flash, if they were built with the
+ * same baked settings. Otherwise it starts from the image alone, and the
+ * first press builds the cache.
+ */
+static bool _use_baked_settings(WIFI_SETTINGS_T *data) {
+	if ((data->magic != SETTINGS_MAGIC_NUM) || (data->baked_id != BAKED_CONFIG_ID)) {
+		DEBUG_LOG("  New baked settings");
+		memcpy_P(data, &_baked_settings, sizeof(*data));
+		data->baked_id = BAKED_CONFIG_ID;
+	} else {
+		for (int i=0; i<g_settings_field_count; i++) {
+			const SETTINGS_FIELD_T *field = &g_settings_fields[i];
+			memcpy_P((uint8_t *)data + field->offset,
+				(const uint8_t *)&_baked_settings + field->offset, field->size);
+		}
+	}
+	// in case mqtt_value or rest_url were changed on the setup page since
+	compile_settings_templates(data);
+	return true;
+}
+#endif
+
+
 /* Fetches settings from flash 
 */
 bool get_settings_from_flash(WIFI_SETTINGS_T *data) {
 	DEBUG_LOG("get_settings_from_flash()");
 
-	char buf[sizeof(*data)];
-	EEPROM.begin(sizeof(buf));
-	EEPROM.get(0, buf);
-	EEPROM.end();
-	memcpy(data, &buf, sizeof(buf));
+	int slot = _settings_slot();
+	if (slot == SLOT_NONE) {
+		memset(data, 0, sizeof(*data));
+		#ifdef BAKED_CONFIG
+		return _use_baked_settings(data);
+		#endif
+		return false;
+	}
+	spi_flash_read(_slot_addr(slot), (uint32_t *)data, sizeof(*data));
 
-	#ifdef DEBUG_MODE
+	#if defined(DEBUG_MODE) && !defined(DEBUG_SERIAL_LATER)
 	char b[10]; // display first part of settings for confirmation, if debugging
-	Serial.print(F("  Settings size: ")); Serial.println(sizeof(buf));
+	Serial.print(F("  Settings size: ")); Serial.print(sizeof(*data));
+	Serial.print(F(", slot ")); Serial.print(slot);
+	Serial.print(F(", seq ")); Serial.println(_slot_seq);
 	Serial.print(F("  Peek: "));
 	char *d = (char *)data;
 	for (int i=0; i<16; i++) {
@@ -71,10 +227,17 @@ bool get_settings_from_flash(WIFI_SETTINGS_T *data) {
 	if ((data->magic==SETTINGS_MAGIC_NUM) && (data->version<SETTINGS_VERSION)) {
 		// upgrade settings
 		DEBUG_LOG("Upgrading settings structure");
+		if (data->version<3) compile_settings_templates(data);
+		if (data->version<4) { // grew to 2048 bytes, new flash space isn't cleared
+			memset(&data->actions, 0, sizeof(*data) - offsetof(WIFI_SETTINGS_T, actions));
+		}
 		data->version=SETTINGS_VERSION;
 		save_settings_to_flash(data);
 	}
 
+	#ifdef BAKED_CONFIG
+	return _use_baked_settings(data);
+	#endif
 	return (data->magic == SETTINGS_MAGIC_NUM);
 }
 
@@ -87,7 +250,9 @@ void default_settings(WIFI_SETTINGS_T *data) {
 	// main settings
 	memset(data, 0, sizeof(*data));
 	data->magic = SETTINGS_MAGIC_NUM;
+	#if FEATURE_MQTT
 	strncpy(data->mqtt_host_str, "homeassistant.local", sizeof(data->mqtt_host_str));
+	#endif
 	data->mqtt_host_port = 1883;
 	strncpy(data->mqtt_user, "username", sizeof(data->mqtt_user));
 	strncpy(data->mqtt_auth, "password", sizeof(data->mqtt_auth));
@@ -95,14 +260,48 @@ void default_settings(WIFI_SETTINGS_T *data) {
 	strncpy(data->mqtt_topic, "wled/lights", sizeof(data->mqtt_topic));
 	strncpy(data->mqtt_value, "T", sizeof(data->mqtt_value));
 	data->version = SETTINGS_VERSION;
+	compile_settings_templates(data);
+}
+
+
+/* Compiles mqtt_value & rest_url placeholders, call after changing them
+ */
+void compile_settings_templates(WIFI_SETTINGS_T *data) {
+	DEBUG_LOG("compile_settings_templates()");
+
+	data->tpl_flags = template_compile(data->mqtt_value_tpl,
+		sizeof(data->mqtt_value_tpl), data->mqtt_value);
+	data->tpl_flags |= template_compile(data->rest_url_tpl,
+		sizeof(data->rest_url_tpl), data->rest_url);
+}
+
+
+/* Look up a host name, trying mDNS first for .local names as those
+ * usually aren't in unicast DNS; returns 0 if that fails.
+ */
+static uint32_t _resolve_host(const char *host, ESP8266WiFiClass *w) {
+	IPAddress ip;
+	uint32_t mdns_ip;
+	if (mdns_is_local_name(host) && mdns_resolve(host, &mdns_ip, MDNS_TIMEOUT)) return mdns_ip;
+	if (w->hostByName(host, ip)) return (uint32_t)ip;
+	DEBUG_LOG1("_resolve_host() FAILED, name length", strlen(host));
+	return 0;
 }
 
 
 /* Stores settings from global WiFi object to linked data
- * structure, fetches IP address of MQTT server.
+ * structure, fetches IP addresses of MQTT server & direct target.
+ * Returns true if any of it changed.
  */
-void build_settings_from_wifi(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w) {
+bool build_settings_from_wifi(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w) {
 	DEBUG_LOG("build_settings_from_wifi()");
+	uint32_t old_ips[] = { data->ip_address, data->ip_gateway, data->ip_mask,
+		data->ip_dns1, data->ip_dns2, data->mqtt_host_ip, data->direct_ip, data->metrics_ip };
+	uint8_t old_bssid[6];
+	memcpy(old_bssid, data->wifi_bssid, 6);
+	uint8_t old_channel = data->wifi_channel;
+	uint32_t old_action_ip[MAX_ACTIONS];
+	memcpy(old_action_ip, data->action_ip, sizeof(old_action_ip));
 
 	// main settings
 	data->ip_address = w->localIP();
@@ -112,21 +311,44 @@ void build_settings_from_wifi(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w) {
 	data->ip_dns2 = w->dnsIP(1);
 	memcpy(data->wifi_bssid, w->BSSID(), 6);
 	data->wifi_channel = w->channel();
-	// look up IP for MQTT server
-	if (data->mqtt_host_str[0]) {
-		IPAddress mqtt_ip;
-		int err = w->hostByName(data->mqtt_host_str, mqtt_ip);
-		if (err==0) { 
-			data->mqtt_host_ip = 0;
-			#ifdef DEBUG_MODE
-			Serial.print(" ** Can't resolve host: "); Serial.println(data->mqtt_host_str); 
-			#endif
-		} else {
-			data->mqtt_host_ip = (uint32_t)mqtt_ip;
-		}
+	// look up IP for MQTT server, if this build has MQTT
+	if (FEATURE_MQTT && data->mqtt_host_str[0]) {
+		data->mqtt_host_ip = _resolve_host(data->mqtt_host_str, w);
 	} else {
 		data->mqtt_host_ip = 0;
 	}
+	// the device a direct trigger goes to, often a .local name too
+	data->direct_ip = 0;
+	char host[50];
+	uint16_t port;
+	const char *path;
+	if (action_parse_url(data->direct_target, "http://", 80, host, sizeof(host), &port, &path)
+			|| action_parse_url(data->direct_target, "udp://", 0, host, sizeof(host), &port, &path)) {
+		IPAddress direct_ip;
+		data->direct_ip = direct_ip.fromString(host)?(uint32_t)direct_ip:_resolve_host(host, w);
+	}
+	// HTTP actions, so a press needs no DNS for them either
+	for (int i=0; i<MAX_ACTIONS; i++) {
+		data->action_ip[i] = 0;
+		if ((data->actions[i].type != ACTION_HTTP) || !action_parse_url(data->actions[i].target,
+				"http://", 80, host, sizeof(host), &port, &path)) continue;
+		IPAddress action_ip;
+		data->action_ip[i] = action_ip.fromString(host)?(uint32_t)action_ip:_resolve_host(host, w);
+	}
+	// and for the metrics collector, if any
+	data->metrics_ip = 0;
+	if (data->metrics_host[0]) {
+		IPAddress metrics_ip;
+		if (metrics_ip.fromString(data->metrics_host)
+				|| w->hostByName(data->metrics_host, metrics_ip)) {
+			data->metrics_ip = (uint32_t)metrics_ip;
+		}
+	}
+	uint32_t new_ips[] = { data->ip_address, data->ip_gateway, data->ip_mask,
+		data->ip_dns1, data->ip_dns2, data->mqtt_host_ip, data->direct_ip, data->metrics_ip };
+	return memcmp(old_ips, new_ips, sizeof(old_ips)) || memcmp(old_bssid, data->wifi_bssid, 6)
+		|| (old_channel != data->wifi_channel)
+		|| memcmp(old_action_ip, data->action_ip, sizeof(old_action_ip));
 }
 
 
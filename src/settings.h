@@ -23,13 +23,44 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
-#include <ESP8266WiFi.h>
+#include <stdint.h>
+
+class ESP8266WiFiClass;
 
 /* Our data structure for WIFI settings */
 #define SETTINGS_MAGIC_NUM 0x1AC4
-#define SETTINGS_VERSION 2
+#define SETTINGS_VERSION 4
+
+/* Extra actions done on each press, in addition to mqtt_topic & rest_url */
+#define MAX_ACTIONS 4
+#define ACTION_NONE 0
+#define ACTION_MQTT 1 // publish value to target topic
+#define ACTION_MQTT_RETAIN 2 // same, but retained
+#define ACTION_HTTP 3 // GET target URL, or POST value if set
+
+struct ACTION_T { // size: 144 bytes
+	uint8_t type;
+	char target[80];
+	char value[63];
+};
+
+/* Per connect strategy statistics, see strategy.h */
+#define STRATEGY_COUNT 3
+
+struct STRATEGY_STATS_T { // size: 6 bytes
+	uint16_t tries;
+	uint16_t wins;
+	uint16_t avg_ms; // moving average of successful connects
+};
+
+/* Latency histograms, see latency_hist.h */
+#define HIST_BUCKETS 16
+#define HIST_TOTAL 0 // power-on to published
+#define HIST_WIFI 1 // setup() to wifi connected
+#define HIST_MQTT 2 // wifi connected to published
+#define HIST_SERIES 3
 
-struct WIFI_SETTINGS_T { // size: 644 bytes
+struct WIFI_SETTINGS_T { // size: 2048 bytes
 	uint16_t magic;
 	uint32_t ip_address;
 	uint32_t ip_gateway;
@@ -51,14 +82,76 @@ struct WIFI_SETTINGS_T { // size: 644 bytes
 	char mqtt_homeassistant_topic[100];
 	uint8_t version;
 	char rest_url[100];
-	char filler[280]; // not used
+	// v3: compiled templates for mqtt_value, rest_url (see template_helper.h)
+	uint8_t mqtt_value_tpl[100];
+	uint8_t rest_url_tpl[100];
+	uint8_t tpl_flags;
+	uint32_t press_seq;
+	// v4: extra actions
+	ACTION_T actions[MAX_ACTIONS];
+	uint16_t press_deadline_ms; // 0 = none, each phase gets its full timeout; see planner.cpp
+	STRATEGY_STATS_T strategy_stats[STRATEGY_COUNT];
+	uint8_t rf_cal_countdown; // boots until the next full RF calibration
+	uint8_t connect_fail_streak; // failed wifi connects in a row
+	int8_t link_rssi; // dBm, averaged over fast connects; 0 = none yet
+	uint8_t link_refresh; // link drifted, refresh the cache (see link_quality.h)
+	uint16_t link_assoc_ms;
+	uint16_t link_tcp_ms;
+	uint32_t metrics_ip; // resolved metrics_host, see metrics.h
+	char metrics_host[40]; // empty = no metrics
+	uint16_t metrics_port; // 0 = METRICS_DEFAULT_PORT
+	uint16_t hist[HIST_SERIES][HIST_BUCKETS]; // press latency, see latency_hist.h
+	uint16_t hist_fast; // presses by outcome
+	uint16_t hist_slow;
+	uint16_t hist_fail;
+	uint16_t hist_since_summary;
+	uint16_t config_skip; // presses until the next remote config check
+	uint32_t config_hash; // of the last remote config applied, see config_sync.h
+	uint8_t hint_bssid[6]; // picked on the setup page, used once by the slow connect
+	uint8_t hint_channel; // 0 = no hint
+	uint32_t direct_ip; // resolved host of direct_target, see direct_trigger.h
+	char direct_target[80]; // http://host[:port]/path or udp://host:port; empty = none
+	char direct_value[64]; // POST body or UDP payload
+	uint32_t baked_id; // BAKED_CONFIG_ID of the image that built the cache, see baked_config.h
+	char update_auth[32]; // password for firmware uploads on the setup page; empty = none allowed
+	uint16_t missed_presses; // not delivered, reported with the next good press
+	uint32_t action_ip[MAX_ACTIONS]; // resolved hosts of HTTP actions, see action_helper.h
+	char filler[128]; // not used
+};
+static_assert(sizeof(WIFI_SETTINGS_T)==2048, "settings size changed");
+
+/* Settings that can be edited, on the setup page & by remote config */
+#define FIELD_STR 0
+#define FIELD_U16 1
+#define FIELD_ACTION_TYPE 2 // ACTION_*, as text
+#define FIELD_SECTION 3 // just a heading on the setup page
+#define FIELD_TYPE_MASK 0x0F
+#define FIELD_NONZERO 0x10 // 0 isn't valid
+#define FIELD_NEW_NETWORK 0x20 // a change resets the strategy statistics
+#define FIELD_RECONNECT 0x40 // a change needs a slow connect to rebuild the cache
+#define FIELD_SECRET 0x80 // not shown on the setup page; changing it there needs the old value
+
+struct SETTINGS_FIELD_T {
+	const char *name; // form field & remote config key
+	const char *label;
+	uint16_t offset;
+	uint8_t size;
+	uint8_t type; // FIELD_* type | flags
 };
 
+extern const SETTINGS_FIELD_T g_settings_fields[];
+extern const int g_settings_field_count;
+
 void save_settings_to_flash(WIFI_SETTINGS_T *data);
+bool peek_settings_in_flash(uint32_t offset, void *dest, uint32_t len);
 bool get_settings_from_flash(WIFI_SETTINGS_T *data);
 void default_settings(WIFI_SETTINGS_T *data);
-void build_settings_from_wifi(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w);
+bool build_settings_from_wifi(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w);
+void compile_settings_templates(WIFI_SETTINGS_T *data);
 void set_settings_ap(WIFI_SETTINGS_T *data, char *ssid, char *auth);
 void show_settings(WIFI_SETTINGS_T *data);
+const SETTINGS_FIELD_T *settings_field_find(const char *name);
+int settings_field_get(const SETTINGS_FIELD_T *field, WIFI_SETTINGS_T *data, char *buf, int size);
+int settings_field_set(const SETTINGS_FIELD_T *field, WIFI_SETTINGS_T *data, const char *value);
 
 #endif
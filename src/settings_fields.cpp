@@ -0,0 +1,147 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* settings_fields.cpp */
+
+/* The settings that can be edited, for the setup page & remote config.
+ * Only plain C here, no Arduino, so the native tests & benchmarks in
+ * test/ can use them.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "settings.h"
+#include "action_request.h"
+
+
+/* Editable settings ----------------------------------------------- */
+/* ----------------------------------------------------------------- */
+
+#define _FIELD(name, label, member, type) \
+	{ name, label, offsetof(WIFI_SETTINGS_T, member), \
+		sizeof(((WIFI_SETTINGS_T *)0)->member), type }
+#define _ACTION_FIELDS(i) \
+	_FIELD("act" #i "_type", "Type (mqtt, mqtt-retain, http, or empty)", actions[i].type, FIELD_ACTION_TYPE), \
+	_FIELD("act" #i "_target", "MQTT Topic or http:// URL", actions[i].target, FIELD_STR | FIELD_RECONNECT), \
+	_FIELD("act" #i "_value", "Value (POST body for http, or empty for GET)", actions[i].value, FIELD_STR)
+
+/* In the order of the setup page */
+const SETTINGS_FIELD_T g_settings_fields[] = {
+	_FIELD("wifi_ssid", "Wifi SSID", wifi_ssid, FIELD_STR | FIELD_RECONNECT | FIELD_NEW_NETWORK),
+	_FIELD("wifi_auth", "Wifi Password", wifi_auth, FIELD_STR | FIELD_RECONNECT),
+	#if FEATURE_MQTT
+	_FIELD("mqtt_host_str", "MQTT Host (or empty)", mqtt_host_str, FIELD_STR | FIELD_RECONNECT),
+	_FIELD("mqtt_port", "MQTT Port", mqtt_host_port, FIELD_U16 | FIELD_NONZERO),
+	_FIELD("mqtt_user", "MQTT Username", mqtt_user, FIELD_STR),
+	_FIELD("mqtt_auth", "MQTT Password", mqtt_auth, FIELD_STR),
+	#endif
+	_FIELD("mqtt_client_id", "MQTT Client ID", mqtt_client_id, FIELD_STR),
+	#if FEATURE_MQTT
+	_FIELD("mqtt_topic", "MQTT Topic", mqtt_topic, FIELD_STR),
+	_FIELD("mqtt_value", "MQTT Topic value ({rssi} {ms} {seq} {mac} {ip} {vcc} {ch})", mqtt_value, FIELD_STR),
+	_FIELD("mqtt_ha", "MQTT Home Assistant Topic", mqtt_homeassistant_topic, FIELD_STR),
+	#endif
+	#if FEATURE_REST
+	_FIELD("rest_url", "REST URL (or empty)", rest_url, FIELD_STR),
+	#endif
+	_FIELD("direct_target", "Direct trigger: http://host/path or udp://host:port (or empty)",
+		direct_target, FIELD_STR | FIELD_RECONNECT),
+	_FIELD("direct_value", "Direct trigger value (POST body or UDP payload, e.g. {\"on\":\"t\"} for WLED's /json/state)",
+		direct_value, FIELD_STR),
+	_FIELD("deadline", "Time limit per press in ms (0 = none)", press_deadline_ms, FIELD_U16),
+	_FIELD("metrics_host", "Metrics host for UDP line protocol (or empty)", metrics_host,
+		FIELD_STR | FIELD_RECONNECT),
+	_FIELD("metrics_port", "Metrics port (0 = 8089)", metrics_port, FIELD_U16),
+	_FIELD("update_auth", "Firmware update password (empty = no updates)", update_auth,
+		FIELD_STR | FIELD_SECRET),
+	{ NULL, "Extra actions", 0, 0, FIELD_SECTION },
+	_ACTION_FIELDS(0), _ACTION_FIELDS(1), _ACTION_FIELDS(2), _ACTION_FIELDS(3)
+};
+const int g_settings_field_count = sizeof(g_settings_fields)/sizeof(g_settings_fields[0]);
+static_assert(MAX_ACTIONS==4, "add _ACTION_FIELDS() for new actions");
+
+
+/* Find an editable setting by name, or NULL */
+const SETTINGS_FIELD_T *settings_field_find(const char *name) {
+	for (int i=0; i<g_settings_field_count; i++) {
+		if (g_settings_fields[i].name && !strcmp(g_settings_fields[i].name, name)) {
+			return &g_settings_fields[i];
+		}
+	}
+	return NULL;
+}
+
+
+/* Current value of a setting as text, returns length */
+int settings_field_get(const SETTINGS_FIELD_T *field, WIFI_SETTINGS_T *data, char *buf, int size) {
+	uint8_t *member = (uint8_t *)data + field->offset;
+	switch (field->type & FIELD_TYPE_MASK) {
+		case FIELD_STR:
+			return snprintf(buf, size, "%s", (char *)member);
+		case FIELD_U16:
+			return snprintf(buf, size, "%u", *(uint16_t *)member);
+		case FIELD_ACTION_TYPE:
+			return snprintf(buf, size, "%s", action_type_name(*member));
+	}
+	if (size) buf[0] = 0;
+	return 0;
+}
+
+
+/* Set a setting from text; returns 1 if it changed, 0 if not, and
+ * -1 if the value isn't valid (too long, not a number), which is ignored.
+ */
+int settings_field_set(const SETTINGS_FIELD_T *field, WIFI_SETTINGS_T *data, const char *value) {
+	uint8_t *member = (uint8_t *)data + field->offset;
+	switch (field->type & FIELD_TYPE_MASK) {
+		case FIELD_STR: {
+			if (strlen(value) >= field->size) return -1;
+			if (!strcmp((char *)member, value)) return 0;
+			strcpy((char *)member, value);
+			break;
+		}
+		case FIELD_U16: {
+			char *end;
+			long int res = strtol(value, &end, 10);
+			if (!*value || *end || res<0 || res>0xFFFF) return -1;
+			if (!res && (field->type & FIELD_NONZERO)) return -1;
+			if (*(uint16_t *)member == res) return 0;
+			*(uint16_t *)member = (uint16_t)res;
+			break;
+		}
+		case FIELD_ACTION_TYPE: {
+			uint8_t type = action_type_from_name(value);
+			if (*member == type) return 0;
+			*member = type;
+			break;
+		}
+		default:
+			return -1;
+	}
+	if (field->type & FIELD_NEW_NETWORK) {
+		// new network, start learning connect strategies again
+		memset(data->strategy_stats, 0, sizeof(data->strategy_stats));
+	}
+	return 1;
+}
@@ -0,0 +1,128 @@
+/*
+  Copyright (c) 2022-2023 John Mueller
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/* strategy.cpp */
+
+/* Some networks connect fastest with the BSSID pinned, some with only the
+ * channel, some only with a plain DHCP connect. We keep success counts and
+ * average connect times per strategy in the settings, and pick the one with
+ * the lowest expected time (epsilon-greedy): usually the best one so far,
+ * sometimes a random one, so changes in the network are noticed.
+ */
+
+#include <Arduino.h>
+
+#include "main.h"
+#include "settings.h"
+#include "strategy.h"
+
+static const char * const _strategy_names[STRATEGY_COUNT] = { "bssid", "channel", "dhcp" };
+
+static uint8_t _last_strategy = STRATEGY_DHCP;
+static bool _last_success;
+static uint32_t _last_ms;
+static bool _last_explored;
+
+
+/* Expected connect time of a strategy, in ms, from its statistics
+ */
+static uint32_t _expected_ms(STRATEGY_STATS_T *stats) {
+	// (wins+1)/(tries+2): untried strategies start at 50% success
+	uint32_t fail_pct = 100 - (100 * (stats->wins + 1)) / (stats->tries + 2);
+	return stats->avg_ms + (fail_pct * STRATEGY_FAIL_COST) / 100;
+}
+
+
+/* Pick the strategy for this press
+ */
+uint8_t strategy_choose(WIFI_SETTINGS_T *data) {
+	DEBUG_LOG("strategy_choose()");
+
+	// without a cache, only a plain connect is possible
+	uint8_t count = (data->ip_address && data->wifi_channel)?STRATEGY_COUNT:1;
+	uint8_t first = STRATEGY_COUNT - count;
+	uint8_t best = STRATEGY_DHCP;
+	_last_explored = false;
+	if (count>1 && (ESP.random() % 100) < STRATEGY_EXPLORE_PCT) {
+		best = first + ESP.random() % count;
+		_last_explored = true;
+	} else {
+		uint32_t best_ms = UINT32_MAX;
+		for (uint8_t i=first; i<STRATEGY_COUNT; i++) {
+			uint32_t ms = _expected_ms(&data->strategy_stats[i]);
+			if (ms < best_ms) { best_ms = ms; best = i; }
+		}
+	}
+	_last_strategy = best;
+	return best;
+}
+
+
+/* Update statistics after a connect attempt, returns true if they changed
+ * & need to be saved. An ordinary press (a success close to the average)
+ * only counts on presses sampled for statistics (weight, see
+ * STATS_SAMPLE_ONE_IN), as that many presses, so the rates stay right
+ * without a flash write per press. Failures & outliers always count.
+ */
+bool strategy_record(WIFI_SETTINGS_T *data, uint8_t strategy, bool success, uint32_t ms,
+		uint8_t weight) {
+	_last_strategy = strategy;
+	_last_success = success;
+	_last_ms = ms;
+	if (strategy >= STRATEGY_COUNT) return false;
+	STRATEGY_STATS_T *stats = &data->strategy_stats[strategy];
+	bool ordinary = success && stats->wins
+		&& (ms + STRATEGY_ORDINARY_MS >= stats->avg_ms)
+		&& (ms <= (uint32_t)stats->avg_ms + STRATEGY_ORDINARY_MS);
+	if (!ordinary) weight = 1;
+	else if (!weight) return false;
+	if (stats->tries + weight > STRATEGY_MAX_TRIES) {
+		stats->tries /= 2;
+		stats->wins /= 2;
+	}
+	stats->tries += weight;
+	if (success) {
+		if (ms > UINT16_MAX) ms = UINT16_MAX;
+		// first win sets the average, then 1/4 weight for new values
+		stats->avg_ms = (stats->wins)?((3 * stats->avg_ms + ms) / 4):ms;
+		stats->wins += weight;
+	}
+	return true;
+}
+
+
+/* Readable name of a strategy */
+const char *strategy_name(uint8_t strategy) {
+	return (strategy < STRATEGY_COUNT)?_strategy_names[strategy]:"?";
+}
+
+
+/* Strategy used for this press */
+uint8_t strategy_last() {
+	return _last_strategy;
+}
+
+
+/* Format the last choice & result for telemetry: "name,ok,ms,explored"
+ */
+int strategy_format_last(char *buf, int size) {
+	return snprintf(buf, size, "%s,%i,%lu,%i", strategy_name(_last_strategy),
+		_last_success?1:0, (unsigned long)_last_ms, _last_explored?1:0);
+}
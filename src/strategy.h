@@ -0,0 +1,45 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* strategy.h - learns which wifi connect strategy works best here */
+
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+#include "settings.h"
+
+// keep in order with _strategy_names in strategy.cpp, max STRATEGY_COUNT
+#define STRATEGY_BSSID 0 // cached BSSID, channel & IP
+#define STRATEGY_CHANNEL 1 // cached channel & IP, any BSSID
+#define STRATEGY_DHCP 2 // plain connect with scan & DHCP
+
+#define STRATEGY_EXPLORE_PCT 10 // how often to try a random strategy
+#define STRATEGY_FAIL_COST 5000 // ms, what a failure costs us, roughly
+#define STRATEGY_MAX_TRIES 100 // halve stats after this, to follow changes
+#define STRATEGY_ORDINARY_MS 100U // a success this close to the average is ordinary
+
+uint8_t strategy_choose(WIFI_SETTINGS_T *data);
+bool strategy_record(WIFI_SETTINGS_T *data, uint8_t strategy, bool success, uint32_t ms,
+	uint8_t weight);
+const char *strategy_name(uint8_t strategy);
+uint8_t strategy_last();
+int strategy_format_last(char *buf, int size);
+
+#endif
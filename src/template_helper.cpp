@@ -0,0 +1,135 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* template_helper.cpp */
+
+/* Placeholders like {rssi} are compiled once, when settings are saved,
+ * into single opcode bytes. Rendering is then one pass over the compiled
+ * bytes, with no format-string parsing while the button is pressed.
+ */
+
+#include <string.h>
+
+#include "template_helper.h"
+
+static const char * const _tpl_names[] = {
+	NULL, "rssi", "ms", "seq", "mac", "ip", "vcc", "ch"
+};
+#define TPL_OP_COUNT (sizeof(_tpl_names)/sizeof(_tpl_names[0]))
+
+
+/* Compile a template string into opcodes, returns TPL_USES() flags.
+ * Unknown placeholders are kept as literal text, control characters are
+ * dropped since they would be read as opcodes.
+ */
+uint8_t template_compile(uint8_t *dest, int size, const char *input) {
+	const char *in_ptr = input;
+	uint8_t *out_ptr = dest;
+	uint8_t flags = 0;
+	while (*in_ptr && (out_ptr - dest < size-1)) {
+		if (*in_ptr=='{') {
+			const char *close = strchr(in_ptr, '}');
+			uint8_t op = 0;
+			if (close) {
+				for (uint8_t i=1; i<TPL_OP_COUNT; i++) {
+					int len = strlen(_tpl_names[i]);
+					if ((close-in_ptr-1 == len) && !strncmp(in_ptr+1, _tpl_names[i], len)) {
+						op = i; break;
+					}
+				}
+			}
+			if (op) {
+				*out_ptr++ = op;
+				flags |= TPL_USES(op);
+				in_ptr = close + 1;
+				continue;
+			}
+		}
+		if ((uint8_t)*in_ptr >= 0x20) *out_ptr++ = *in_ptr;
+		in_ptr++;
+	}
+	*out_ptr = TPL_OP_END;
+	return flags;
+}
+
+
+/* Append an unsigned number, returns new write position */
+static char *_put_uint(char *out_ptr, char *end, uint32_t value) {
+	char digits[10];
+	int n = 0;
+	do { digits[n++] = '0' + (value % 10); value /= 10; } while (value);
+	while (n && out_ptr<end) *out_ptr++ = digits[--n];
+	return out_ptr;
+}
+
+
+/* Append one byte as two hex digits, returns new write position */
+static char *_put_hex(char *out_ptr, char *end, uint8_t value) {
+	static const char hex[] = "0123456789ABCDEF";
+	if (out_ptr<end) *out_ptr++ = hex[value>>4];
+	if (out_ptr<end) *out_ptr++ = hex[value&0x0f];
+	return out_ptr;
+}
+
+
+/* Render a compiled template into dest, always zero-terminated.
+ * Returns the length written.
+ */
+int template_render(char *dest, int size, const uint8_t *tpl, TEMPLATE_CONTEXT_T *ctx) {
+	char *out_ptr = dest;
+	char *end = dest + size - 1;
+	while (*tpl && out_ptr<end) {
+		switch (*tpl) {
+			case TPL_OP_RSSI:
+				if ((ctx->rssi<0) && (out_ptr<end)) *out_ptr++ = '-';
+				out_ptr = _put_uint(out_ptr, end, (ctx->rssi<0)?-ctx->rssi:ctx->rssi);
+				break;
+			case TPL_OP_MS:
+				out_ptr = _put_uint(out_ptr, end, ctx->ms);
+				break;
+			case TPL_OP_SEQ:
+				out_ptr = _put_uint(out_ptr, end, ctx->seq);
+				break;
+			case TPL_OP_MAC:
+				for (int i=0; i<6; i++) {
+					if (i && out_ptr<end) *out_ptr++ = ':';
+					out_ptr = _put_hex(out_ptr, end, ctx->mac[i]);
+				}
+				break;
+			case TPL_OP_IP:
+				for (int i=0; i<4; i++) { // stored in network order
+					if (i && out_ptr<end) *out_ptr++ = '.';
+					out_ptr = _put_uint(out_ptr, end, (ctx->ip >> (8*i)) & 0xff);
+				}
+				break;
+			case TPL_OP_VCC:
+				out_ptr = _put_uint(out_ptr, end, ctx->vcc);
+				break;
+			case TPL_OP_CH:
+				out_ptr = _put_uint(out_ptr, end, ctx->channel);
+				break;
+			default:
+				*out_ptr++ = *tpl;
+		}
+		tpl++;
+	}
+	*out_ptr = 0;
+	return out_ptr - dest;
+}
@@ -0,0 +1,55 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* template_helper.h - placeholders in MQTT values & REST URLs */
+
+#ifndef TEMPLATE_HELPER_H
+#define TEMPLATE_HELPER_H
+
+#include <stdint.h>
+
+/* Opcodes in a compiled template; anything >= 0x20 is a literal byte */
+#define TPL_OP_END  0x00
+#define TPL_OP_RSSI 0x01 // {rssi} - wifi signal in dBm
+#define TPL_OP_MS   0x02 // {ms}   - millis since start of setup()
+#define TPL_OP_SEQ  0x03 // {seq}  - press counter, stored in settings
+#define TPL_OP_MAC  0x04 // {mac}  - device MAC address
+#define TPL_OP_IP   0x05 // {ip}   - device IP address
+#define TPL_OP_VCC  0x06 // {vcc}  - supply voltage in mV
+#define TPL_OP_CH   0x07 // {ch}   - wifi channel
+
+/* Flags returned by template_compile(), one bit per opcode used */
+#define TPL_USES(op) (1<<(op))
+
+/* Values available at render time, filled in by the caller */
+struct TEMPLATE_CONTEXT_T {
+	int32_t rssi;
+	uint32_t ms;
+	uint32_t seq;
+	uint8_t mac[6];
+	uint32_t ip;
+	uint16_t vcc;
+	uint8_t channel;
+};
+
+uint8_t template_compile(uint8_t *dest, int size, const char *input);
+int template_render(char *dest, int size, const uint8_t *tpl, TEMPLATE_CONTEXT_T *ctx);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* text_escape.cpp */
+
+/* Only plain C here, no Arduino, so the native benchmarks in test/ can
+ * time the escaping of the setup page & the autodiscovery payload.
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "text_escape.h"
+
+
+/* Escape this string as a JSON value
+ *   Backspace -> \b
+ *   Form feed -> \f
+ *   Newline -> \n
+ *   Carriage return -> \r
+ *   Tab -> \t
+ *   Double quote -> \"
+ *   Backslash -> \\
+ */
+void escape_json_value(char *dest, int size, const char *input) {
+	const char *in_ptr = input;
+	char *out_ptr = dest;
+	while (*in_ptr) {
+		if (strchr("\"\\\b\f\n\r\t", *in_ptr) != NULL) {
+			*out_ptr = '\\'; out_ptr++;
+		}
+		*out_ptr = *in_ptr;
+		if (*out_ptr=='\b') *out_ptr='b'; // special cases
+		if (*out_ptr=='\f') *out_ptr='f';
+		if (*out_ptr=='\n') *out_ptr='n';
+		if (*out_ptr=='\r') *out_ptr='r';
+		if (*out_ptr=='\t') *out_ptr='t';
+		out_ptr++; in_ptr++;
+		if (out_ptr - dest>size-2) break;
+	}
+	*out_ptr=0;
+}
+
+
+/* Escape as much of input as fits into dest for HTML: entities are
+ * ignored, everything but letters & digits is escaped. Returns the
+ * number of input characters done; call again for the rest.
+ */
+int escape_html(char *dest, int size, const char *input) {
+	const char *in_ptr = input;
+	char *out_ptr = dest;
+	// one escaped character takes up to 7, "&#-128;"
+	while (*in_ptr && (out_ptr - dest <= size - 8)) {
+		if (isalnum(*in_ptr)) {
+			*out_ptr=*in_ptr; out_ptr++;
+		} else {
+			out_ptr += sprintf(out_ptr, "&#%i;", *in_ptr);
+		}
+		in_ptr++;
+	}
+	*out_ptr=0;
+	return in_ptr - input;
+}
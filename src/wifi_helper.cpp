@@ -33,45 +33,57 @@
 
 /* Connect to the AP using traditional SSID, AUTH
  */
-bool wifi_slow_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w) {
+bool wifi_slow_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w, uint32_t timeout_ms) {
 	DEBUG_LOG("wifi_slow_connect()");
 
-	#define SLOW_TIMEOUT 10000 // ms
 	w->mode(WIFI_STA);
+	w->config(0U, 0U, 0U); // back to DHCP, if a fast connect set a static IP
+	uint32_t timeout = millis() + timeout_ms;
+	if (data->hint_channel) {
+		// network picked on the setup page: no scan needed, if it's still there
+		w->begin(data->wifi_ssid, data->wifi_auth, data->hint_channel, data->hint_bssid);
+		uint32_t hint_timeout = millis() + timeout_ms/2;
+		while ((WiFi.status() != WL_CONNECTED) && (millis()<hint_timeout)) { delay(10); }
+		data->hint_channel = 0; // only once, the cache takes over
+		if (WiFi.status() == WL_CONNECTED) return true;
+	}
 	w->begin(data->wifi_ssid, data->wifi_auth);
-	uint32_t timeout = millis() + SLOW_TIMEOUT;
 	while ((WiFi.status() != WL_CONNECTED) && (millis()<timeout)) { delay(10); }
 	return (WiFi.status() == WL_CONNECTED);
 }
 
 
-/* Try a slow connection
- * returns true if connected, false if failure
+/* Try a slow connection & rebuild the cache; the caller saves it, if
+ * changed says so. returns true if connected, false if failure
  */
-bool wifi_try_slow_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w) {
+bool wifi_try_slow_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w, uint32_t timeout_ms,
+		bool *changed) {
 	DEBUG_LOG("wifi_try_slow_connect()");
 
 	//set_settings_ap(data, (char *)WIFI_SSID, (char *)WIFI_AUTH);
-	if (!wifi_slow_connect(data, w)) {
+	uint8_t hint_channel = data->hint_channel; // used up by the connect
+	if (!wifi_slow_connect(data, w, timeout_ms)) {
 		DEBUG_LOG("wifi_slow_connect() FAILED");
+		if (changed) *changed = (hint_channel != data->hint_channel);
 		return false;
 	}
 
-	build_settings_from_wifi(data, w);
-	save_settings_to_flash(data);
-	#ifdef DEBUG_MODE
+	bool res = build_settings_from_wifi(data, w);
+	if (changed) *changed = res || (hint_channel != data->hint_channel);
+	#if defined(DEBUG_MODE) && !defined(DEBUG_SERIAL_LATER)
 	show_settings(data);
 	#endif
 	return true;
 }
 
 
-/* Attempt to connect to the AP using our cached AP data
+/* Attempt to connect to the AP using our cached AP data; without
+ * pin_bssid only the channel is used, so any AP with our SSID will do.
  */
-bool wifi_try_fast_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w) {
+bool wifi_try_fast_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w, uint32_t timeout_ms,
+		bool pin_bssid) {
 	DEBUG_LOG("wifi_try_fast_connect()");
 
-	#define FAST_TIMEOUT 5000 // ms
 	if (!data->ip_address || !data->wifi_channel) return false;
 
 	WiFi.persistent(true);
@@ -82,9 +94,10 @@ bool wifi_try_fast_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w) {
 		IPAddress(data->ip_gateway), IPAddress(data->ip_mask),
 		IPAddress(data->ip_dns1), IPAddress(data->ip_dns2));
 
-	w->begin(data->wifi_ssid, data->wifi_auth, data->wifi_channel, data->wifi_bssid, true);
+	w->begin(data->wifi_ssid, data->wifi_auth, data->wifi_channel,
+		pin_bssid?data->wifi_bssid:NULL, true);
 	// wait for connection, or time out
-	uint32_t timeout = millis() + FAST_TIMEOUT;
+	uint32_t timeout = millis() + timeout_ms;
 	while ((w->status() != WL_CONNECTED) && (millis()<timeout)) { 
 		delay(5); 
 	}
@@ -26,9 +26,14 @@
 #include "settings.h"
 #include <ESP8266WiFi.h>
 
-bool wifi_try_slow_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w);
-bool wifi_slow_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w);
-bool wifi_try_fast_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w);
+#define SLOW_TIMEOUT 10000 // ms
+#define FAST_TIMEOUT 5000 // ms
+
+bool wifi_try_slow_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w, uint32_t timeout_ms=SLOW_TIMEOUT,
+	bool *changed=NULL);
+bool wifi_slow_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w, uint32_t timeout_ms=SLOW_TIMEOUT);
+bool wifi_try_fast_connect(WIFI_SETTINGS_T *data, ESP8266WiFiClass *w, uint32_t timeout_ms=FAST_TIMEOUT,
+	bool pin_bssid=true);
 void show_wifi_info(ESP8266WiFiClass *w);
 
 #endif
@@ -0,0 +1,131 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* test_action_request - action_request.cpp, "pio test -e native" */
+
+#include <unity.h>
+#include <string.h>
+
+#include "settings.h"
+#include "action_request.h"
+
+static char _host[16];
+static uint16_t _port;
+static const char *_path;
+
+
+void setUp() {}
+void tearDown() {}
+
+
+static bool _parse(const char *url, const char *scheme, uint16_t default_port) {
+	_host[0] = 0;
+	_port = 0xffff;
+	_path = NULL;
+	return action_parse_url(url, scheme, default_port, _host, sizeof(_host), &_port, &_path);
+}
+
+
+void test_parse_url() {
+	TEST_ASSERT_TRUE(_parse("http://192.168.1.5/json/state", "http://", 80));
+	TEST_ASSERT_EQUAL_STRING("192.168.1.5", _host);
+	TEST_ASSERT_EQUAL_UINT16(80, _port);
+	TEST_ASSERT_EQUAL_STRING("/json/state", _path);
+
+	TEST_ASSERT_TRUE(_parse("http://wled.local:8080/win&T=2", "http://", 80));
+	TEST_ASSERT_EQUAL_STRING("wled.local", _host);
+	TEST_ASSERT_EQUAL_UINT16(8080, _port);
+	TEST_ASSERT_EQUAL_STRING("/win&T=2", _path);
+
+	TEST_ASSERT_TRUE(_parse("http://host", "http://", 80));
+	TEST_ASSERT_EQUAL_STRING("host", _host);
+	TEST_ASSERT_EQUAL_STRING("/", _path);
+}
+
+
+void test_parse_direct_url() {
+	// the direct trigger tries udp:// first, then http://
+	TEST_ASSERT_TRUE(_parse("udp://10.0.0.2:21324", "udp://", 0));
+	TEST_ASSERT_EQUAL_STRING("10.0.0.2", _host);
+	TEST_ASSERT_EQUAL_UINT16(21324, _port);
+	TEST_ASSERT_EQUAL_STRING("/", _path);
+	TEST_ASSERT_FALSE(_parse("udp://host", "udp://", 0)); // needs a port
+	TEST_ASSERT_FALSE(_parse("http://wled.local/json/state", "udp://", 0));
+	TEST_ASSERT_TRUE(_parse("http://wled.local/json/state", "http://", 80));
+	TEST_ASSERT_FALSE(_parse("udp://10.0.0.2:21324", "http://", 80));
+}
+
+
+void test_parse_url_rejects() {
+	TEST_ASSERT_FALSE(_parse("https://host/", "http://", 80)); // no TLS
+	TEST_ASSERT_FALSE(_parse("", "http://", 80));
+	TEST_ASSERT_FALSE(_parse("http://", "http://", 80));
+	TEST_ASSERT_FALSE(_parse("http:///path", "http://", 80));
+	TEST_ASSERT_FALSE(_parse("http://:80/", "http://", 80));
+	TEST_ASSERT_FALSE(_parse("http://host:0/", "http://", 80));
+	TEST_ASSERT_FALSE(_parse("http://host:x/", "http://", 80));
+
+	// the host must fit, with its 0
+	TEST_ASSERT_TRUE(_parse("http://abcdefghijklmno/", "http://", 80));
+	TEST_ASSERT_EQUAL_STRING("abcdefghijklmno", _host);
+	TEST_ASSERT_FALSE(_parse("http://abcdefghijklmnop/", "http://", 80));
+}
+
+
+void test_type_names() {
+	// names on the setup page & in pushed configs
+	TEST_ASSERT_EQUAL_STRING("", action_type_name(ACTION_NONE));
+	TEST_ASSERT_EQUAL_STRING("mqtt-retain", action_type_name(ACTION_MQTT_RETAIN));
+	TEST_ASSERT_EQUAL_STRING("", action_type_name(200));
+	for (uint8_t type=ACTION_MQTT; type<=ACTION_HTTP; type++) {
+		TEST_ASSERT_EQUAL_UINT8(type, action_type_from_name(action_type_name(type)));
+	}
+	TEST_ASSERT_EQUAL_UINT8(ACTION_NONE, action_type_from_name(""));
+	TEST_ASSERT_EQUAL_UINT8(ACTION_NONE, action_type_from_name("https"));
+}
+
+
+void test_http_request() {
+	char buf[200];
+	static const char get[] = "GET /a HTTP/1.1\r\nHost: h\r\nConnection: close\r\n\r\n";
+	TEST_ASSERT_EQUAL_INT(strlen(get), action_http_request(buf, sizeof(buf), "h", "/a", ""));
+	TEST_ASSERT_EQUAL_STRING(get, buf);
+
+	static const char post[] = "POST /json HTTP/1.1\r\nHost: h\r\n"
+		"Content-Type: application/json\r\nContent-Length: 8\r\n"
+		"Connection: close\r\n\r\n{\"on\":1}";
+	TEST_ASSERT_EQUAL_INT(strlen(post), action_http_request(buf, sizeof(buf), "h", "/json", "{\"on\":1}"));
+	TEST_ASSERT_EQUAL_STRING(post, buf);
+
+	// one byte short for the final 0
+	TEST_ASSERT_EQUAL_INT(-1, action_http_request(buf, strlen(get), "h", "/a", ""));
+	TEST_ASSERT_EQUAL_INT(strlen(get), action_http_request(buf, strlen(get)+1, "h", "/a", ""));
+}
+
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_parse_url);
+	RUN_TEST(test_parse_direct_url);
+	RUN_TEST(test_parse_url_rejects);
+	RUN_TEST(test_type_names);
+	RUN_TEST(test_http_request);
+	return UNITY_END();
+}
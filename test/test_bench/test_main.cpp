@@ -0,0 +1,147 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* test_bench - host benchmarks of the pure helpers, "pio test -e native
+ * -f test_bench -v" prints them as CSV for tools/bench_compare.py; flash
+ * & heap are only measured on the device, see src/benchmark.cpp
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "settings.h"
+#include "template_helper.h"
+#include "text_escape.h"
+#include "config_parse.h"
+
+static WIFI_SETTINGS_T _settings;
+static TEMPLATE_CONTEXT_T _ctx = { -67, 1234, 42, {1, 2, 3, 4, 5, 6}, 0x0104a8c0, 3300, 6 };
+static char _out[300];
+
+// what a setup page submit or a pushed config brings, one value per field
+static const char * const _form[][2] = {
+	{ "wifi_ssid", "home" }, { "wifi_auth", "secret password" },
+	{ "mqtt_host_str", "broker.local" }, { "mqtt_port", "1883" },
+	{ "mqtt_client_id", "button-01" }, { "mqtt_topic", "home/doorbell" },
+	{ "mqtt_value", "{\"on\":\"t\",\"rssi\":{rssi},\"seq\":{seq}}" },
+	{ "direct_target", "http://wled.local/json/state" }, { "deadline", "6000" },
+	{ "act0_type", "http" }, { "act0_target", "http://10.0.0.2/win&T=2" },
+	{ "act1_type", "mqtt" }, { "act1_target", "home/bell/ring" },
+};
+#define FORM_FIELDS (int)(sizeof(_form)/sizeof(_form[0]))
+
+
+/* Run fn() iterations times, print a line like src/benchmark.cpp does;
+ * there's no heap to watch here, so that column is 0
+ */
+template <typename T>
+static void _bench(const char *name, int iterations, T fn) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i=0; i<iterations; i++) fn();
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+	printf("bench,%s,%i,%lu,0\n", name, iterations, (unsigned long)(ns / iterations));
+}
+
+
+/* Like _handle_form(): look up & set each field */
+static int _apply_form() {
+	int changes = 0;
+	for (int i=0; i<FORM_FIELDS; i++) {
+		const SETTINGS_FIELD_T *field = settings_field_find(_form[i][0]);
+		if (field && (settings_field_set(field, &_settings, _form[i][1]) > 0)) changes++;
+	}
+	return changes;
+}
+
+
+/* Like config_apply(), for config_parse() */
+static int _apply_line(const char *name, const char *value, void *ctx) {
+	const SETTINGS_FIELD_T *field = settings_field_find(name);
+	return field?settings_field_set(field, (WIFI_SETTINGS_T *)ctx, value):-1;
+}
+
+
+void setUp() {
+	memset(&_settings, 0, sizeof(_settings));
+	strcpy(_settings.mqtt_value, "{\"on\":\"t\",\"rssi\":{rssi},\"seq\":{seq},\"mac\":\"{mac}\"}");
+}
+void tearDown() {}
+
+
+void test_bench_templates() {
+	_bench("template_compile", 100000, []() {
+		_settings.tpl_flags = template_compile(_settings.mqtt_value_tpl,
+			sizeof(_settings.mqtt_value_tpl), _settings.mqtt_value);
+	});
+	_bench("template_render", 100000, []() {
+		template_render(_out, sizeof(_out), _settings.mqtt_value_tpl, &_ctx);
+	});
+	TEST_ASSERT_EQUAL_STRING("{\"on\":\"t\",\"rssi\":-67,\"seq\":42,\"mac\":\"01:02:03:04:05:06\"}", _out);
+}
+
+
+void test_bench_escaping() {
+	_bench("escape_json_value", 100000, []() {
+		escape_json_value(_out, 100, "softplus/\"quoted\"\\path\twith\ttabs/state");
+	});
+	TEST_ASSERT_EQUAL_STRING("softplus/\\\"quoted\\\"\\\\path\\twith\\ttabs/state", _out);
+	_bench("escape_html", 100000, []() {
+		const char *in = _settings.mqtt_value;
+		do { in += escape_html(_out, 100, in); } while (*in);
+	});
+}
+
+
+void test_bench_settings_fields() {
+	_bench("settings_field_set_form", 20000, []() {
+		memset(&_settings, 0, sizeof(_settings));
+		_apply_form();
+	});
+	TEST_ASSERT_EQUAL_STRING("broker.local", _settings.mqtt_host_str);
+	TEST_ASSERT_EQUAL_UINT16(6000, _settings.press_deadline_ms);
+	TEST_ASSERT_EQUAL_UINT8(ACTION_HTTP, _settings.actions[0].type);
+
+	char config[600] = "";
+	for (int i=0; i<FORM_FIELDS; i++) {
+		strcat(config, _form[i][0]); strcat(config, "="); strcat(config, _form[i][1]); strcat(config, "\n");
+	}
+	_bench("config_parse_settings", 20000, [&config]() {
+		char text[sizeof(config)];
+		int errors;
+		strcpy(text, config);
+		memset(&_settings, 0, sizeof(_settings));
+		config_parse(text, _apply_line, &_settings, &errors);
+	});
+	TEST_ASSERT_EQUAL_STRING("home/bell/ring", _settings.actions[1].target);
+}
+
+
+int main() {
+	UNITY_BEGIN();
+	printf("bench,name,iterations,ns_per_op,peak_heap_bytes\n");
+	RUN_TEST(test_bench_templates);
+	RUN_TEST(test_bench_escaping);
+	RUN_TEST(test_bench_settings_fields);
+	printf("bench,done\n");
+	return UNITY_END();
+}
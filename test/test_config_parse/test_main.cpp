@@ -0,0 +1,103 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* test_config_parse - config_parse.cpp, "pio test -e native" */
+
+#include <unity.h>
+#include <string.h>
+
+#include "config_parse.h"
+
+// lines handed to _record(), as "name=value;"
+static char _seen[300];
+
+
+void setUp() {}
+void tearDown() {}
+
+
+/* Stands in for the settings: "bad" is unknown, "same" doesn't change,
+ * a value "?" is invalid, anything else changes.
+ */
+static int _record(const char *name, const char *value, void *ctx) {
+	(*(int *)ctx)++;
+	strcat(_seen, name);
+	strcat(_seen, "=");
+	strcat(_seen, value);
+	strcat(_seen, ";");
+	if (!strcmp(name, "bad") || !strcmp(value, "?")) return -1;
+	return strcmp(name, "same")?1:0;
+}
+
+
+/* Parse a copy of input, check the lines seen & the counts */
+static void _expect_parse(const char *input, const char *seen, int changes, int errors) {
+	char text[200];
+	int calls = 0, errors_found = -1;
+	strcpy(text, input);
+	_seen[0] = 0;
+	TEST_ASSERT_EQUAL_INT(changes, config_parse(text, _record, &calls, &errors_found));
+	TEST_ASSERT_EQUAL_STRING(seen, _seen);
+	TEST_ASSERT_EQUAL_INT(errors, errors_found);
+}
+
+
+void test_lines() {
+	_expect_parse("mqtt_topic=home/bell\nmqtt_port=1883\n",
+		"mqtt_topic=home/bell;mqtt_port=1883;", 2, 0);
+	_expect_parse("a=1", "a=1;", 1, 0); // no final newline
+	_expect_parse("a=1\r\nb=2\r\n", "a=1;b=2;", 2, 0);
+	_expect_parse("value={\"a\":\"b=c\"}\n", "value={\"a\":\"b=c\"};", 1, 0); // first "=" splits
+	_expect_parse("empty=\n", "empty=;", 1, 0);
+	_expect_parse("same=1\na=2\n", "same=1;a=2;", 1, 0);
+	_expect_parse("", "", 0, 0);
+}
+
+
+void test_comments_and_blanks() {
+	_expect_parse("# pushed by config_push.py\n\na=1\n\r\n#b=2\n", "a=1;", 1, 0);
+	_expect_parse("\n\n\n", "", 0, 0);
+}
+
+
+void test_errors() {
+	_expect_parse("no equals sign\na=1\n", "a=1;", 1, 1);
+	_expect_parse("bad=1\na=?\nb=2\n", "bad=1;a=?;b=2;", 1, 2);
+	_expect_parse("=1\n", "=1;", 1, 0); // empty names are up to the callback
+}
+
+
+void test_hash() {
+	// FNV-1a test vectors; tools/config_push.py uses the same
+	TEST_ASSERT_EQUAL_UINT32(0x811c9dc5UL, config_hash("", 0));
+	TEST_ASSERT_EQUAL_UINT32(0xe40c292cUL, config_hash("a", 1));
+	TEST_ASSERT_EQUAL_UINT32(0xbf9cf968UL, config_hash("foobar", 6));
+	TEST_ASSERT_EQUAL_UINT32(0xe40c292cUL, config_hash("ab", 1)); // only len bytes
+}
+
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_lines);
+	RUN_TEST(test_comments_and_blanks);
+	RUN_TEST(test_errors);
+	RUN_TEST(test_hash);
+	return UNITY_END();
+}
@@ -0,0 +1,153 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* test_mdns - mdns_packet.cpp with captured responses, "pio test -e native" */
+
+#include <unity.h>
+#include <string.h>
+
+#include "mdns_packet.h"
+
+// legacy unicast answers (RFC 6762, 6.7): our id, the question repeated,
+// names compressed against it; the IP is kept in network order
+static const uint8_t _avahi_legacy[] = {
+	0x12, 0x34, 0x84, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x06, 0x62, 0x72, 0x6f, 0x6b, 0x65, 0x72, 0x05, 0x6c, 0x6f, 0x63, 0x61,
+	0x6c, 0x00, 0x00, 0x01, 0x00, 0x01, 0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01,
+	0x00, 0x00, 0x00, 0x0a, 0x00, 0x04, 0xc0, 0xa8, 0x01, 0x14,
+};
+static const uint8_t _multiple_answers[] = {
+	0xbe, 0xef, 0x84, 0x00, 0x00, 0x01, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00,
+	0x06, 0x62, 0x72, 0x6f, 0x6b, 0x65, 0x72, 0x05, 0x6c, 0x6f, 0x63, 0x61,
+	0x6c, 0x00, 0x00, 0x01, 0x00, 0x01, 0xc0, 0x0c, 0x00, 0x1c, 0x80, 0x01,
+	0x00, 0x00, 0x00, 0x78, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x70,
+	0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0xc0, 0x13, 0x00, 0x01, 0x80, 0x01,
+	0x00, 0x00, 0x00, 0x78, 0x00, 0x04, 0x0a, 0x00, 0x00, 0x09, 0x06, 0x42,
+	0x72, 0x6f, 0x6b, 0x65, 0x72, 0xc0, 0x13, 0x00, 0x01, 0x80, 0x01, 0x00,
+	0x00, 0x00, 0x78, 0x00, 0x04, 0x0a, 0x00, 0x00, 0x05,
+};
+static const uint8_t _additional_only[] = {
+	0x00, 0x42, 0x84, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+	0x06, 0x62, 0x72, 0x6f, 0x6b, 0x65, 0x72, 0x05, 0x6c, 0x6f, 0x63, 0x61,
+	0x6c, 0x00, 0x00, 0x01, 0x00, 0x01, 0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01,
+	0x00, 0x00, 0x00, 0x0a, 0x00, 0x04, 0xac, 0x10, 0x00, 0x07,
+};
+static const uint8_t _no_question[] = {
+	0x00, 0x07, 0x84, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x06, 0x42, 0x52, 0x4f, 0x4b, 0x45, 0x52, 0x05, 0x4c, 0x6f, 0x63, 0x61,
+	0x6c, 0x00, 0x00, 0x01, 0x80, 0x01, 0x00, 0x00, 0x11, 0x94, 0x00, 0x04,
+	0xc0, 0xa8, 0x00, 0x02,
+};
+static const uint8_t _pointer_loop[] = {
+	0x00, 0x08, 0x84, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x04,
+	0x00, 0x00, 0x00, 0x00,
+};
+static const uint8_t _other_name[] = {
+	0x00, 0x09, 0x84, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x07, 0x62, 0x72, 0x6f, 0x6b, 0x65, 0x72, 0x73, 0x05, 0x6c, 0x6f, 0x63,
+	0x61, 0x6c, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00,
+	0x04, 0x01, 0x02, 0x03, 0x04,
+};
+
+
+void setUp() {}
+void tearDown() {}
+
+
+/* Parse a packet, checks the address if expected is given */
+static void _expect_answer(const uint8_t *packet, int len, uint16_t id, const uint8_t *expected) {
+	uint32_t ip = 0;
+	bool found = mdns_parse_answer(packet, len, id, "broker.local", &ip);
+	if (!expected) {
+		TEST_ASSERT_FALSE(found);
+		return;
+	}
+	TEST_ASSERT_TRUE(found);
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, (uint8_t *)&ip, 4);
+}
+
+
+void test_build_query() {
+	static const uint8_t expected[] = {
+		0xab, 0xcd, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+		6, 'b', 'r', 'o', 'k', 'e', 'r', 5, 'l', 'o', 'c', 'a', 'l', 0,
+		0, 1, 0, 1 };
+	uint8_t buf[64];
+	memset(buf, 0xff, sizeof(buf));
+	TEST_ASSERT_EQUAL_INT(sizeof(expected), mdns_build_query(buf, sizeof(buf), 0xabcd, "broker.local"));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buf, sizeof(expected));
+	// too small, empty label
+	TEST_ASSERT_EQUAL_INT(0, mdns_build_query(buf, sizeof(expected)-1, 1, "broker.local"));
+	TEST_ASSERT_EQUAL_INT(0, mdns_build_query(buf, sizeof(buf), 1, "broker..local"));
+}
+
+
+void test_compressed_answer() {
+	static const uint8_t ip[] = { 192, 168, 1, 20 };
+	_expect_answer(_avahi_legacy, sizeof(_avahi_legacy), 0x1234, ip);
+}
+
+
+void test_multiple_answers() {
+	// AAAA first, then another host's A, then ours, in mixed case
+	// & compressed against the "local" of the question
+	static const uint8_t ip[] = { 10, 0, 0, 5 };
+	_expect_answer(_multiple_answers, sizeof(_multiple_answers), 0xbeef, ip);
+}
+
+
+void test_additional_section() {
+	static const uint8_t ip[] = { 172, 16, 0, 7 };
+	_expect_answer(_additional_only, sizeof(_additional_only), 0x0042, ip);
+}
+
+
+void test_no_question() {
+	static const uint8_t ip[] = { 192, 168, 0, 2 };
+	_expect_answer(_no_question, sizeof(_no_question), 0x0007, ip);
+}
+
+
+void test_rejects() {
+	_expect_answer(_avahi_legacy, sizeof(_avahi_legacy), 0x4321, NULL); // other id
+	_expect_answer(_avahi_legacy, sizeof(_avahi_legacy)-1, 0x1234, NULL); // truncated
+	_expect_answer(_avahi_legacy, 11, 0x1234, NULL);
+	_expect_answer(_pointer_loop, sizeof(_pointer_loop), 0x0008, NULL);
+	_expect_answer(_other_name, sizeof(_other_name), 0x0009, NULL); // "brokers.local"
+
+	uint8_t query[sizeof(_avahi_legacy)];
+	memcpy(query, _avahi_legacy, sizeof(query));
+	query[2] = 0; // a query, not a response
+	_expect_answer(query, sizeof(query), 0x1234, NULL);
+}
+
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_build_query);
+	RUN_TEST(test_compressed_answer);
+	RUN_TEST(test_multiple_answers);
+	RUN_TEST(test_additional_section);
+	RUN_TEST(test_no_question);
+	RUN_TEST(test_rejects);
+	return UNITY_END();
+}
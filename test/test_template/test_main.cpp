@@ -0,0 +1,150 @@
+/*
+	Copyright (c) 2022-2023 John Mueller
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/* test_template - template_helper.cpp, "pio test -e native" */
+
+#include <unity.h>
+#include <string.h>
+
+#include "template_helper.h"
+
+static TEMPLATE_CONTEXT_T _ctx = {
+	-67, 1234, 42, {0x00, 0x1a, 0x2b, 0x3c, 0x4d, 0xfe}, 0x0401a8c0, 3300, 6
+};
+
+
+void setUp() {}
+void tearDown() {}
+
+
+/* Compile & render input with enough room, check the text & flags */
+static void _expect_render(const char *input, const char *expected, uint8_t flags) {
+	uint8_t tpl[100];
+	char out[100];
+	TEST_ASSERT_EQUAL_UINT8(flags, template_compile(tpl, sizeof(tpl), input));
+	int len = template_render(out, sizeof(out), tpl, &_ctx);
+	TEST_ASSERT_EQUAL_STRING(expected, out);
+	TEST_ASSERT_EQUAL_INT(strlen(expected), len);
+}
+
+
+void test_each_placeholder() {
+	_expect_render("{rssi}", "-67", TPL_USES(TPL_OP_RSSI));
+	_expect_render("{ms}", "1234", TPL_USES(TPL_OP_MS));
+	_expect_render("{seq}", "42", TPL_USES(TPL_OP_SEQ));
+	_expect_render("{mac}", "00:1A:2B:3C:4D:FE", TPL_USES(TPL_OP_MAC));
+	_expect_render("{ip}", "192.168.1.4", TPL_USES(TPL_OP_IP));
+	_expect_render("{vcc}", "3300", TPL_USES(TPL_OP_VCC));
+	_expect_render("{ch}", "6", TPL_USES(TPL_OP_CH));
+}
+
+
+void test_mixed_text() {
+	_expect_render("{\"rssi\":{rssi},\"seq\":{seq}}", "{\"rssi\":-67,\"seq\":42}",
+		TPL_USES(TPL_OP_RSSI) | TPL_USES(TPL_OP_SEQ));
+	_expect_render("http://h/p?ms={ms}&ms2={ms}", "http://h/p?ms=1234&ms2=1234", TPL_USES(TPL_OP_MS));
+	_expect_render("", "", 0);
+
+	// 0 & positive values, no sign
+	TEMPLATE_CONTEXT_T saved = _ctx;
+	_ctx.rssi = 0; _ctx.seq = 0;
+	_expect_render("{rssi}/{seq}", "0/0", TPL_USES(TPL_OP_RSSI) | TPL_USES(TPL_OP_SEQ));
+	_ctx.rssi = 5; _ctx.ms = 4294967295UL;
+	_expect_render("{rssi} {ms}", "5 4294967295", TPL_USES(TPL_OP_RSSI) | TPL_USES(TPL_OP_MS));
+	_ctx = saved;
+}
+
+
+void test_unknown_placeholders() {
+	_expect_render("{foo}", "{foo}", 0);
+	_expect_render("{RSSI}", "{RSSI}", 0);
+	_expect_render("{rssi2}", "{rssi2}", 0);
+	_expect_render("{}", "{}", 0);
+	_expect_render("{rssi", "{rssi", 0); // no closing brace
+	_expect_render("{{seq}}", "{42}", TPL_USES(TPL_OP_SEQ));
+	_expect_render("{x}{ch}", "{x}6", TPL_USES(TPL_OP_CH));
+}
+
+
+void test_control_characters_dropped() {
+	_expect_render("a\x01" "b\tc\x07" "d", "abcd", 0);
+}
+
+
+void test_render_truncates() {
+	uint8_t tpl[100];
+	char out[16];
+	memset(out, 'x', sizeof(out));
+	template_compile(tpl, sizeof(tpl), "abcdef");
+	TEST_ASSERT_EQUAL_INT(3, template_render(out, 4, tpl, &_ctx));
+	TEST_ASSERT_EQUAL_STRING("abc", out);
+	TEST_ASSERT_EQUAL_UINT8('x', out[4]);
+
+	template_compile(tpl, sizeof(tpl), "{mac}");
+	TEST_ASSERT_EQUAL_INT(7, template_render(out, 8, tpl, &_ctx));
+	TEST_ASSERT_EQUAL_STRING("00:1A:2", out);
+	TEST_ASSERT_EQUAL_UINT8('x', out[8]);
+
+	template_compile(tpl, sizeof(tpl), "rssi={rssi}");
+	TEST_ASSERT_EQUAL_INT(6, template_render(out, 7, tpl, &_ctx));
+	TEST_ASSERT_EQUAL_STRING("rssi=-", out);
+	TEST_ASSERT_EQUAL_INT(7, template_render(out, 8, tpl, &_ctx));
+	TEST_ASSERT_EQUAL_STRING("rssi=-6", out);
+
+	template_compile(tpl, sizeof(tpl), "{ip}");
+	TEST_ASSERT_EQUAL_INT(5, template_render(out, 6, tpl, &_ctx));
+	TEST_ASSERT_EQUAL_STRING("192.1", out);
+	TEST_ASSERT_EQUAL_INT(0, template_render(out, 1, tpl, &_ctx));
+	TEST_ASSERT_EQUAL_STRING("", out);
+}
+
+
+void test_compile_overflow() {
+	uint8_t tpl[8];
+	memset(tpl, 0xee, sizeof(tpl));
+	template_compile(tpl, 5, "abcdefgh");
+	TEST_ASSERT_EQUAL_MEMORY("abcd", tpl, 4);
+	TEST_ASSERT_EQUAL_UINT8(TPL_OP_END, tpl[4]);
+	TEST_ASSERT_EQUAL_UINT8(0xee, tpl[5]);
+
+	// a placeholder is one byte, so one more fits; the rest is cut
+	memset(tpl, 0xee, sizeof(tpl));
+	uint8_t flags = template_compile(tpl, 5, "ab{seq}{ch}{ms}");
+	TEST_ASSERT_EQUAL_UINT8(TPL_USES(TPL_OP_SEQ) | TPL_USES(TPL_OP_CH), flags);
+	static const uint8_t expected[] = { 'a', 'b', TPL_OP_SEQ, TPL_OP_CH, TPL_OP_END, 0xee };
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, tpl, sizeof(expected));
+
+	memset(tpl, 0xee, sizeof(tpl));
+	template_compile(tpl, 1, "{rssi}");
+	TEST_ASSERT_EQUAL_UINT8(TPL_OP_END, tpl[0]);
+	TEST_ASSERT_EQUAL_UINT8(0xee, tpl[1]);
+}
+
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_each_placeholder);
+	RUN_TEST(test_mixed_text);
+	RUN_TEST(test_unknown_placeholders);
+	RUN_TEST(test_control_characters_dropped);
+	RUN_TEST(test_render_truncates);
+	RUN_TEST(test_compile_overflow);
+	return UNITY_END();
+}
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Load-test the setup page & captive DNS of a button in AP mode.
+
+Join the button's access point ("AP_xxxxxx"), then e.g. emulate 4 phones
+reloading the portal for 30 seconds:
+
+    python3 tools/ap_loadtest.py --clients 4 --duration 30
+
+Each client keeps its connection open like a browser does, and picks
+requests by weight from --mix: the setup page (root), the form without
+changes (form, so nothing is written to flash), unknown pages for our own
+address (404), unknown pages for other hosts (captive, redirected), OS
+portal checks (probe), and DNS queries for random names (dns). Prints
+requests per second, latency percentiles and bytes per response for
+each, and the device's free heap low-water mark during the run, from
+/stats. --json gives the same as JSON, e.g. to compare two builds.
+"""
+
+import argparse
+import http.client
+import json
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+from common import percentile
+
+DEFAULT_MIX = "root=6,form=1,404=1,captive=1,probe=1,dns=2"
+REQUESTS = {
+    # kind: (path, Host header or None for the device's address)
+    "root": ("/", None),
+    "form": ("/get?submit=Save+settings", None),
+    "404": ("/favicon.ico", None),
+    "captive": ("/", "example.com"),
+    "probe": ("/generate_204", "connectivitycheck.gstatic.com"),
+}
+
+
+def dns_query(ip, name, timeout):
+    """One A query, returns the reply's size; raises on timeout."""
+    qid = random.randrange(65536)
+    packet = struct.pack(">HHHHHH", qid, 0x0100, 1, 0, 0, 0)
+    packet += b"".join(bytes([len(p)]) + p.encode() for p in name.split(".")) + b"\0"
+    packet += struct.pack(">HH", 1, 1)
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+        sock.settimeout(timeout)
+        sock.sendto(packet, (ip, 53))
+        while True:
+            reply, _ = sock.recvfrom(512)
+            if reply[:2] == packet[:2]:
+                return len(reply)
+
+
+def read_stats(ip, timeout, reset=False):
+    """Free heap, its low-water mark & the smallest largest block from /stats."""
+    conn = http.client.HTTPConnection(ip, timeout=timeout)
+    conn.request("GET", "/stats?reset=1" if reset else "/stats")
+    text = conn.getresponse().read().decode(errors="replace")
+    conn.close()
+    head = text.split()
+    values = {head[i]: head[i + 1] for i in range(0, len(head) - 1) if head[i] in ("heap", "min", "block")}
+    blocks = [int(line.split("block")[1].split()[0]) for line in text.splitlines()[2:] if " block " in line]
+    return {"heap": int(values.get("heap", 0)), "min": int(values.get("min", 0)),
+            "block": min(blocks + [int(values.get("block", 0))])}
+
+
+class Results:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.ms = {}
+        self.bytes = {}
+        self.errors = {}
+
+    def add(self, kind, ms=None, size=0):
+        with self.lock:
+            if ms is None:
+                self.errors[kind] = self.errors.get(kind, 0) + 1
+                return
+            self.ms.setdefault(kind, []).append(ms)
+            self.bytes.setdefault(kind, []).append(size)
+
+
+def client(ip, kinds, weights, deadline, timeout, results):
+    conn = None
+    while time.monotonic() < deadline:
+        kind = random.choices(kinds, weights)[0]
+        start = time.monotonic()
+        try:
+            if kind == "dns":
+                size = dns_query(ip, f"x{random.randrange(1 << 30)}.example.com", timeout)
+            else:
+                path, host = REQUESTS[kind]
+                if conn is None:
+                    conn = http.client.HTTPConnection(ip, timeout=timeout)
+                conn.request("GET", path, headers={"Host": host or ip})
+                resp = conn.getresponse()
+                size = len(resp.read())
+                if resp.getheader("Connection", "").lower() == "close":
+                    conn.close()
+                    conn = None
+            results.add(kind, (time.monotonic() - start) * 1000, size)
+        except (OSError, http.client.HTTPException):
+            results.add(kind)
+            if conn:
+                conn.close()
+            conn = None
+    if conn:
+        conn.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--ip", default="192.168.4.1")
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--duration", type=float, default=30.0, help="seconds")
+    parser.add_argument("--mix", default=DEFAULT_MIX, help="kind=weight,...")
+    parser.add_argument("--timeout", type=float, default=10.0)
+    parser.add_argument("--json", action="store_true")
+    args = parser.parse_args()
+
+    mix = dict(item.split("=") for item in args.mix.split(","))
+    for kind in mix:
+        if kind != "dns" and kind not in REQUESTS:
+            sys.exit(f"unknown kind {kind}, use: {', '.join(list(REQUESTS) + ['dns'])}")
+    kinds, weights = list(mix), [float(w) for w in mix.values()]
+
+    before = read_stats(args.ip, args.timeout, reset=True)
+    results = Results()
+    deadline = time.monotonic() + args.duration
+    threads = [threading.Thread(target=client, args=(args.ip, kinds, weights, deadline, args.timeout, results))
+               for _ in range(args.clients)]
+    start = time.monotonic()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.monotonic() - start
+    after = read_stats(args.ip, args.timeout)
+
+    report = {"clients": args.clients, "seconds": round(elapsed, 1), "kinds": {}}
+    for kind in kinds:
+        ms = results.ms.get(kind, [])
+        sizes = results.bytes.get(kind, [])
+        report["kinds"][kind] = {
+            "ok": len(ms), "errors": results.errors.get(kind, 0),
+            "rps": round(len(ms) / elapsed, 2),
+            **{f"p{p}_ms": round(percentile(ms, p), 1) for p in (50, 90, 99)},
+            "max_ms": round(max(ms), 1) if ms else None,
+            "bytes": round(sum(sizes) / len(sizes)) if sizes else None,
+        }
+    total = sum(k["ok"] for k in report["kinds"].values())
+    report["rps"] = round(total / elapsed, 2)
+    report["heap"] = {"free_before": before["heap"], "min_free": after["min"],
+                      "peak_use": before["heap"] - after["min"], "min_block": after["block"]}
+    if args.json:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+        return
+
+    print(f"{args.clients} clients, {elapsed:.1f} s, {report['rps']} requests/s")
+    print(f"{'kind':<8} {'ok':>6} {'err':>4} {'rps':>7} {'p50':>7} {'p90':>7} {'p99':>7} {'max':>7} {'bytes':>7}")
+    for kind, r in report["kinds"].items():
+        print(f"{kind:<8} {r['ok']:>6} {r['errors']:>4} {r['rps']:>7} {r['p50_ms']:>7} {r['p90_ms']:>7} "
+              f"{r['p99_ms']:>7} {r['max_ms'] if r['max_ms'] is not None else '-':>7} {r['bytes'] or '-':>7}")
+    heap = report["heap"]
+    print(f"heap: {heap['free_before']} free before, lowest {heap['min_free']} "
+          f"(peak use {heap['peak_use']} bytes), smallest largest block {heap['min_block']}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""Bake a button's settings into its firmware image, for fleets.
+
+Takes "name=value" lines like config_push.py does (names of the setup page,
+g_settings_fields in src/settings_fields.cpp), and writes src/baked_config.h with
+a constant WIFI_SETTINGS_T for builds with BAKED_CONFIG (the esp01_baked
+environment in platformio.ini). Such a button needs no setup page, which
+then rejects changes, and has no remote configuration; only the cache &
+statistics are kept in flash. It doesn't boot faster than a normal build.
+
+    python3 tools/bake_config.py fleet.conf
+    pio run -e esp01_baked -t upload
+
+Or one image per device, each with its own mqtt_client_id, in baked/:
+
+    python3 tools/bake_config.py fleet.conf --count 20 --id-format "button-{n:02d}"
+    python3 tools/bake_config.py fleet.conf --ids ids.txt --out images
+
+Between devices only the header changes, so each build just recompiles
+settings.cpp and links. baked/manifest.csv lists id, image, size & MD5.
+src/baked_config.h holds the wifi & MQTT passwords; don't commit it.
+"""
+
+import argparse
+import csv
+import hashlib
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+from common import fnv1a
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+SRC_DIR = os.path.join(ROOT, "src")
+HEADER = os.path.join(SRC_DIR, "baked_config.h")
+ACTION_TYPES = {"": "ACTION_NONE", "mqtt": "ACTION_MQTT", "mqtt-retain": "ACTION_MQTT_RETAIN",
+                "http": "ACTION_HTTP"}  # _action_names in src/action_request.cpp
+DEFAULTS = {"mqtt_port": "1883"}  # as default_settings() in src/settings.cpp
+
+
+def read_struct(text, name):
+    """Members of a struct in declaration order, as (name, char array size or None)."""
+    body = re.search(r"struct %s \{[^\n]*\n(.*?)\n\};" % name, text, re.S).group(1)
+    members = []
+    for line in body.splitlines():
+        match = re.match(r"\s*\w+\s+(\w+)((?:\[\w+\])*);", line)
+        if match:
+            size = re.fullmatch(r"\[(\d+)\]", match.group(2))
+            members.append((match.group(1), int(size.group(1)) if size else None))
+    return members
+
+
+def read_fields():
+    """Setup page fields: name -> (struct member, FIELD_* type, flags)."""
+    with open(os.path.join(SRC_DIR, "settings_fields.cpp")) as f:
+        text = f.read()
+    fields = {}
+    for name, member, flags in re.findall(
+            r'_FIELD\(\s*"(\w+)",\s*"(?:[^"\\]|\\.)*",\s*(\w+),\s*(FIELD_\w+(?:\s*\|\s*FIELD_\w+)*)\)', text):
+        flags = [flag.strip() for flag in flags.split("|")]
+        fields[name] = (member, flags[0], flags[1:])
+    return fields
+
+
+def c_string(value):
+    out = []
+    for byte in value.encode():
+        if chr(byte) in '"\\':
+            out.append("\\" + chr(byte))
+        elif 32 <= byte < 127:
+            out.append(chr(byte))
+        else:
+            out.append(f"\\{byte:03o}")
+    return '"' + "".join(out) + '"'
+
+
+def initializers(settings, fields, members, action_members, max_actions):
+    """".member = value" per set struct member; exits on invalid values."""
+    sizes = dict(members)
+    values = {}
+    actions = {}
+    for name, value in settings.items():
+        match = re.fullmatch(r"act(\d+)_(type|target|value)", name)
+        if match:
+            actions.setdefault(int(match.group(1)), {})[match.group(2)] = value
+            continue
+        if name not in fields:
+            sys.exit(f"unknown setting: {name}")
+        member, kind, flags = fields[name]
+        if kind == "FIELD_STR":
+            if len(value.encode()) >= sizes[member]:
+                sys.exit(f"{name} is too long, up to {sizes[member] - 1} bytes")
+            values[member] = c_string(value)
+        elif kind == "FIELD_U16":
+            if not value.isdigit() or int(value) > 0xFFFF or (not int(value) and "FIELD_NONZERO" in flags):
+                sys.exit(f"{name} must be a number up to 65535" + (", not 0" if "FIELD_NONZERO" in flags else ""))
+            values[member] = str(int(value))
+    if actions:
+        sizes = dict(action_members)
+        rows = []
+        for i in range(max_actions):
+            action = actions.pop(i, {})
+            if action.get("type", "") not in ACTION_TYPES:
+                sys.exit(f"act{i}_type must be one of: {', '.join(repr(t) for t in ACTION_TYPES)}")
+            for part in ("target", "value"):
+                if len(action.get(part, "").encode()) >= sizes[part]:
+                    sys.exit(f"act{i}_{part} is too long, up to {sizes[part] - 1} bytes")
+            rows.append(f"{{ {ACTION_TYPES[action.get('type', '')]}, {c_string(action.get('target', ''))}, "
+                        f"{c_string(action.get('value', ''))} }}")
+        if actions:
+            sys.exit(f"only {max_actions} actions, act0 to act{max_actions - 1}")
+        values["actions"] = "{\n\t\t" + ",\n\t\t".join(rows) + "\n\t}"
+    values["magic"] = "SETTINGS_MAGIC_NUM"
+    values["version"] = "SETTINGS_VERSION"
+    return [f"\t.{member} = {values[member]}," for member, _ in members if member in values]
+
+
+def write_header(settings, source, layout):
+    lines = "".join(f"{name}={value}\n" for name, value in sorted(settings.items())).encode()
+    baked_id = fnv1a(lines) or 1  # 0 is what older settings have
+    text = (f"/* baked_config.h - settings for BAKED_CONFIG builds, see src/settings.cpp\n"
+            f" * Generated by tools/bake_config.py from {source}; don't edit, and\n"
+            f" * don't commit it, it holds the wifi & MQTT passwords.\n"
+            f" */\n\n"
+            f"#ifndef BAKED_CONFIG_H\n#define BAKED_CONFIG_H\n\n"
+            f"#include \"settings.h\"\n\n"
+            f"#define BAKED_CONFIG_ID 0x{baked_id:08x}UL // hash of the settings, see baked_id\n\n"
+            f"#pragma GCC diagnostic push\n"
+            f"#pragma GCC diagnostic ignored \"-Wmissing-field-initializers\" // the rest is 0\n"
+            f"static const WIFI_SETTINGS_T _baked_settings PROGMEM = {{\n"
+            + "\n".join(initializers(settings, *layout))
+            + "\n};\n#pragma GCC diagnostic pop\n\n#endif\n")
+    with open(HEADER, "w") as f:
+        f.write(text)
+    return baked_id
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("config", nargs="?", help="file with NAME=VALUE lines")
+    parser.add_argument("--set", action="append", default=[], metavar="NAME=VALUE")
+    parser.add_argument("--id", action="append", default=[], help="build an image with this mqtt_client_id")
+    parser.add_argument("--ids", help="file with one mqtt_client_id per line")
+    parser.add_argument("--count", type=int, default=0, help="build this many images, ids from --id-format")
+    parser.add_argument("--id-format", default="button-{n:03d}", help="with --count, n counts from 1")
+    parser.add_argument("--env", default="esp01_baked", help="platformio environment")
+    parser.add_argument("--out", default=os.path.join(ROOT, "baked"), help="directory for the images")
+    args = parser.parse_args()
+
+    lines = []
+    if args.config:
+        with open(args.config) as f:
+            lines += [line.rstrip("\r\n") for line in f if line.strip() and not line.startswith("#")]
+    lines += args.set
+    settings = dict(DEFAULTS)
+    for line in lines:
+        name, sep, value = line.partition("=")
+        if not sep:
+            sys.exit(f"not NAME=VALUE: {line}")
+        settings[name.strip()] = value
+    with open(os.path.join(SRC_DIR, "settings.h")) as f:
+        text = f.read()
+    max_actions = int(re.search(r"#define MAX_ACTIONS (\d+)", text).group(1))
+    layout = (read_fields(), read_struct(text, "WIFI_SETTINGS_T"), read_struct(text, "ACTION_T"), max_actions)
+    source = os.path.basename(args.config) if args.config else "--set"
+
+    ids = list(args.id)
+    if args.ids:
+        with open(args.ids) as f:
+            ids += [line.strip() for line in f if line.strip() and not line.startswith("#")]
+    ids += [args.id_format.format(n=n) for n in range(1, args.count + 1)]
+    if len(set(ids)) != len(ids):
+        sys.exit("mqtt_client_id values must be unique")
+    if not ids:
+        baked_id = write_header(settings, source, layout)
+        print(f"wrote {os.path.relpath(HEADER)}, id {baked_id:08x}; now: pio run -e {args.env} -t upload")
+        return
+
+    os.makedirs(args.out, exist_ok=True)
+    image = os.path.join(ROOT, ".pio", "build", args.env, "firmware.bin")
+    start = time.monotonic()
+    with open(os.path.join(args.out, "manifest.csv"), "w", newline="") as f:
+        manifest = csv.writer(f)
+        manifest.writerow(["mqtt_client_id", "image", "bytes", "md5", "baked_id"])
+        for i, client_id in enumerate(ids):
+            built = time.monotonic()
+            baked_id = write_header(dict(settings, mqtt_client_id=client_id), source, layout)
+            result = subprocess.run(["pio", "run", "-e", args.env, "-d", ROOT], capture_output=True, text=True)
+            if result.returncode:
+                sys.exit(result.stdout + result.stderr)
+            name = re.sub(r"[^\w.-]", "_", client_id) + ".bin"
+            shutil.copyfile(image, os.path.join(args.out, name))
+            with open(image, "rb") as bin_file:
+                data = bin_file.read()
+            manifest.writerow([client_id, name, len(data), hashlib.md5(data).hexdigest(), f"{baked_id:08x}"])
+            print(f"{i + 1}/{len(ids)} {client_id}: {name}, {len(data)} bytes, "
+                  f"{time.monotonic() - built:.1f} s", file=sys.stderr)
+    # leave the header of the fleet settings, not of the last device
+    write_header(settings, source, layout)
+    seconds = time.monotonic() - start
+    print(f"{len(ids)} images in {os.path.relpath(args.out)}, {seconds:.0f} s, "
+          f"{seconds / len(ids):.1f} s per image")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""Compare two benchmark runs, from Serial with DEBUG_BENCHMARK or from test_bench.
+
+    pio device monitor | tee before.txt   (flash, press reset, wait for "bench,done")
+    pio test -e native -f test_bench -v | tee before.txt
+    python3 tools/bench_compare.py before.txt after.txt [--json]
+
+Lines that don't start with "bench," are ignored, so raw serial logs work.
+"""
+
+import argparse
+import csv
+import json
+import sys
+
+
+def read_run(path):
+    results = {}
+    with open(path, errors="replace") as f:
+        rows = csv.reader(line for line in f if line.startswith("bench,"))
+        for row in rows:
+            if len(row) != 5 or row[1] == "name":
+                continue
+            results[row[1]] = {"iterations": int(row[2]), "ns_per_op": int(row[3]),
+                               "peak_heap_bytes": int(row[4])}
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("before")
+    parser.add_argument("after")
+    parser.add_argument("--json", action="store_true", help="machine-readable output")
+    args = parser.parse_args()
+
+    before, after = read_run(args.before), read_run(args.after)
+    report = {}
+    for name in list(before) + [n for n in after if n not in before]:
+        b, a = before.get(name), after.get(name)
+        entry = {"before": b, "after": a}
+        if b and a and b["ns_per_op"]:
+            entry["change_pct"] = round((a["ns_per_op"] - b["ns_per_op"]) * 100.0 / b["ns_per_op"], 1)
+        report[name] = entry
+
+    if args.json:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+        return
+    print(f"{'benchmark':32} {'before ns':>10} {'after ns':>10} {'change':>8} {'heap b/a':>12}")
+    for name, entry in report.items():
+        b, a = entry["before"], entry["after"]
+        change = f"{entry['change_pct']:+.1f}%" if "change_pct" in entry else "-"
+        heap = f"{b['peak_heap_bytes'] if b else '-'}/{a['peak_heap_bytes'] if a else '-'}"
+        print(f"{name:32} {b['ns_per_op'] if b else '-':>10} {a['ns_per_op'] if a else '-':>10} "
+              f"{change:>8} {heap:>12}")
+
+
+if __name__ == "__main__":
+    main()
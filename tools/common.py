@@ -0,0 +1,26 @@
+"""Helpers shared by the scripts in tools/; they import it from their own
+directory, so run them as "python3 tools/<name>.py".
+"""
+
+import math
+
+FNV_OFFSET = 2166136261  # as in src/config_parse.cpp
+FNV_PRIME = 16777619
+
+
+def fnv1a(data):
+    """32-bit FNV-1a hash of bytes, like config_hash() on the device."""
+    value = FNV_OFFSET
+    for byte in data:
+        value = ((value ^ byte) * FNV_PRIME) & 0xFFFFFFFF
+    return value
+
+
+def percentile(values, p):
+    """p-th percentile, interpolated between the closest ranks; nan if empty."""
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    k = (len(values) - 1) * p / 100.0
+    lo, hi = math.floor(k), math.ceil(k)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Push settings to a button over MQTT, see src/config_sync.cpp.
+
+Publishes "name=value" lines retained to softplus/<client id>/config/set,
+then their FNV-1a hash to softplus/<client id>/config/hash. The button
+applies them after its next press, and reports "hash,changes,errors" on
+softplus/<client id>/config/state. Names are the ones of the setup page
+(g_settings_fields in src/settings_fields.cpp), e.g.:
+
+    python3 tools/config_push.py button1 --set mqtt_topic=home/doorbell --set deadline=6000
+    python3 tools/config_push.py button1 --file kitchen.conf --host 192.168.1.5
+
+Without --host, only prints the mosquitto_pub commands to run.
+"""
+
+import argparse
+import shlex
+import subprocess
+import sys
+
+from common import fnv1a
+
+MAX_SIZE = 1024  # CONFIG_MAX_SIZE in src/config_sync.h, incl. the final 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("client_id", help="MQTT client id of the button")
+    parser.add_argument("--set", action="append", default=[], metavar="NAME=VALUE")
+    parser.add_argument("--file", help="file with NAME=VALUE lines")
+    parser.add_argument("--host", help="MQTT broker; publishes with mosquitto_pub")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("-u", "--user")
+    parser.add_argument("-P", "--password")
+    args = parser.parse_args()
+
+    lines = []
+    if args.file:
+        with open(args.file) as f:
+            lines += [line.rstrip("\r\n") for line in f if line.strip() and not line.startswith("#")]
+    lines += args.set
+    for line in lines:
+        if "=" not in line:
+            sys.exit(f"not NAME=VALUE: {line}")
+    payload = "\n".join(lines).encode()
+    if len(payload) >= MAX_SIZE:
+        sys.exit(f"config is {len(payload)} bytes, the device takes up to {MAX_SIZE - 1}")
+    digest = f"{fnv1a(payload):08x}"
+
+    base = f"softplus/{args.client_id}/config"
+    commands = []
+    for topic, message in ((f"{base}/set", payload.decode()), (f"{base}/hash", digest)):
+        cmd = ["mosquitto_pub", "-r", "-t", topic, "-m", message]
+        if args.host:
+            cmd += ["-h", args.host, "-p", str(args.port)]
+        if args.user:
+            cmd += ["-u", args.user]
+        if args.password:
+            cmd += ["-P", args.password]
+        commands.append(cmd)
+
+    print(f"hash {digest}, {len(lines)} settings, {len(payload)} bytes", file=sys.stderr)
+    for cmd in commands:
+        if args.host:
+            subprocess.run(cmd, check=True)
+        else:
+            print(" ".join(shlex.quote(part) for part in cmd))
+    if args.host:
+        print(f"watch {base}/state for the result after the next press", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,393 @@
+#!/usr/bin/env python3
+"""Discrete-event simulator for the button's connect strategy.
+
+Models an access point (association delay, channel changes, BSSID roaming,
+DHCP reassignment) and an MQTT broker (TCP RTT, CONNACK delay, restarts),
+and runs many simulated presses through the same steps as setup() in
+src/main.cpp: the connect strategy picked like src/strategy.cpp does (fast
+connect with the cached BSSID, channel & IP, with only the channel & IP,
+or a plain DHCP connect), fallback to a slow connect, then MQTT connect &
+publish, each limited by the press deadline like src/planner.cpp does.
+The timeouts, the planner's phase table and the strategy constants are
+read from the firmware sources, so changing them there changes the
+simulation too. The direct trigger, extra actions & REST aren't modelled.
+Energy per press uses the current profile in src/energy.h (ENERGY_*_MA,
+ENERGY_*_TX_PCT) and BLINK_MS, per phase like the firmware's estimate.
+
+    python3 tools/connect_sim.py --presses 5000
+    python3 tools/connect_sim.py --set FAST_TIMEOUT=2000 --json
+    python3 tools/connect_sim.py --deadline 6000
+    python3 tools/connect_sim.py --set BLINK_MS=500 --set ENERGY_RX_MA=70
+
+Distributions are given as "const:X", "uniform:A,B", "exp:MEAN",
+"lognormal:MEDIAN,SIGMA" or "normal:MEAN,SD", all in ms (or hours for the
+*_every settings), and can be changed with --param name=dist.
+"""
+
+import argparse
+import heapq
+import json
+import math
+import os
+import random
+import re
+import sys
+
+from common import percentile
+
+SRC_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+
+# network & device model; times in ms unless noted
+DEFAULT_PARAMS = {
+    "press_every": "exp:8",             # hours between presses
+    "boot": "normal:60,10",             # power-on to RF init
+    "rf_cal_quick": "normal:10,2",      # RF init to setup(), with the stored calibration
+    "rf_cal_full": "normal:200,15",     # same, full calibration
+    "settings_read": "const:3",
+    "assoc_fast": "lognormal:250,0.4",  # association with BSSID & channel known
+    "probe_channel": "lognormal:120,0.3",  # extra, finding the BSSID with only the channel known
+    "scan": "lognormal:1800,0.2",       # full scan before a slow connect
+    "assoc_slow": "lognormal:400,0.4",
+    "dhcp": "lognormal:350,0.5",
+    "dns": "lognormal:40,0.8",
+    "flash_write": "const:25",
+    "tcp_rtt": "lognormal:6,0.6",
+    "connack": "lognormal:15,0.8",
+    "channel_change_every": "exp:720",  # hours
+    "roam_every": "exp:2000",           # hours, another BSSID takes over
+    "dhcp_reassign_every": "exp:500",   # hours, our cached IP goes to someone else
+    "broker_ip_change_every": "exp:4000",
+    "broker_restart_every": "exp:168",
+    "broker_down": "lognormal:20000,0.5",
+}
+DEFAULT_PROBS = {
+    "slow_fail": 0.01,   # slow connect fails even though the AP is fine
+    "fast_fail": 0.005,  # fast connect fails with a correct cache
+    "user_refresh": 0.3, # after a failed press, the user holds the button to refresh the cache
+}
+
+ENERGY_PHASES = ("boot", "cal", "settings", "wifi", "send", "blink", "led")
+STRATEGIES = ("bssid", "channel", "dhcp")  # _strategy_names in src/strategy.cpp
+
+
+def read_firmware_defines():
+    """Collect "#define NAME 1234" constants from the firmware sources."""
+    defines = {}
+    pattern = re.compile(r"^\s*#define\s+([A-Z_]+)\s+(\d+)[UL]*\b", re.M)
+    for name in os.listdir(SRC_DIR):
+        if name.endswith((".cpp", ".h")):
+            with open(os.path.join(SRC_DIR, name)) as f:
+                for key, value in pattern.findall(f.read()):
+                    defines.setdefault(key, int(value))
+    return defines
+
+
+def make_dist(spec, rng):
+    kind, _, args = spec.partition(":")
+    vals = [float(v) for v in args.split(",")] if args else []
+    if kind == "const":
+        return lambda: vals[0]
+    if kind == "uniform":
+        return lambda: rng.uniform(vals[0], vals[1])
+    if kind == "exp":
+        return lambda: rng.expovariate(1.0 / vals[0])
+    if kind == "lognormal":
+        return lambda: rng.lognormvariate(math.log(vals[0]), vals[1])
+    if kind == "normal":
+        return lambda: max(0.0, rng.gauss(vals[0], vals[1]))
+    raise ValueError(f"unknown distribution: {spec}")
+
+
+class Network:
+    """State of AP & broker; changes are scheduled as discrete events."""
+
+    def __init__(self, dist, now=0.0):
+        self.dist = dist
+        self.channel = 1
+        self.bssid = 1
+        self.ip_epoch = 0      # bumps when our old IP is handed to someone else
+        self.broker_ip = 1
+        self.broker_down_until = -1.0
+        self.events = []
+        for kind in ("channel_change", "roam", "dhcp_reassign", "broker_ip_change", "broker_restart"):
+            self.schedule(now, kind)
+
+    def schedule(self, now, kind):
+        hours = self.dist[kind + "_every"]()
+        heapq.heappush(self.events, (now + hours * 3600e3, kind))
+
+    def advance(self, until):
+        while self.events and self.events[0][0] <= until:
+            when, kind = heapq.heappop(self.events)
+            if kind == "channel_change":
+                self.channel = self.channel % 13 + 1
+            elif kind == "roam":
+                self.bssid += 1
+            elif kind == "dhcp_reassign":
+                self.ip_epoch += 1
+            elif kind == "broker_ip_change":
+                self.broker_ip += 1
+            elif kind == "broker_restart":
+                self.broker_down_until = when + self.dist["broker_down"]()
+            self.schedule(when, kind)
+
+
+class Device:
+    """Cached connection data, like WIFI_SETTINGS_T."""
+
+    def __init__(self):
+        self.channel = 0  # 0 = no cache, forces slow connect
+        self.bssid = 0
+        self.ip_epoch = -1
+        self.broker_ip = 0
+        self.rf_cal_countdown = 0  # like WIFI_SETTINGS_T, 0 = full calibration next
+        self.fail_streak = 0
+        self.stats = {name: [0, 0, 0] for name in STRATEGIES}  # tries, wins, avg_ms
+
+
+def read_planner_phases(consts):
+    """Phases from _phases in src/planner.cpp, in PLAN_PHASE_T order (src/planner.h):
+    name -> (min_ms, max_ms, reserve_ms), with the defines in consts filled in."""
+    with open(os.path.join(SRC_DIR, "planner.h")) as f:
+        enum = re.search(r"enum PLAN_PHASE_T[^{]*\{(.*?)\}", f.read(), re.S).group(1)
+    names = [name for name in re.findall(r"\b(PLAN_\w+)", enum) if name != "PLAN_PHASE_COUNT"]
+    with open(os.path.join(SRC_DIR, "planner.cpp")) as f:
+        table = re.search(r"_phases\[PLAN_PHASE_COUNT\] = \{(.*?)\n\};", f.read(), re.S).group(1)
+    rows = re.findall(r"\{([^{}]*)\}", re.sub(r"//[^\n]*", "", table))
+    if len(rows) != len(names):
+        sys.exit(f"src/planner.cpp: {len(rows)} phases in _phases, {len(names)} in PLAN_PHASE_T")
+
+    def value(expr):
+        expr = re.sub(r"\b[A-Z_][A-Z0-9_]*\b", lambda m: str(consts[m.group(0)]), expr)
+        if not re.fullmatch(r"[\d\s+\-*/()]+", expr):
+            sys.exit(f"src/planner.cpp: can't evaluate {expr!r}")
+        return eval(expr)  # only digits & operators left
+
+    return {name: tuple(value(part) for part in row.split(",")) for name, row in zip(names, rows)}
+
+
+def budget(consts, t, phase):
+    """Like planner_budget() in src/planner.cpp; 0 = skip the phase."""
+    min_ms, max_ms, reserve_ms = consts["phases"][phase]
+    remaining = max(0.0, consts["deadline"] - t)
+    value = min(max_ms, max(0.0, remaining - reserve_ms))
+    return value if value >= min_ms else 0
+
+
+def expected_ms(stats, consts):
+    """_expected_ms() in src/strategy.cpp."""
+    tries, wins, avg_ms = stats
+    fail_pct = 100 - (100 * (wins + 1)) // (tries + 2)
+    return avg_ms + fail_pct * consts["STRATEGY_FAIL_COST"] // 100
+
+
+def choose_strategy(dev, consts, rng):
+    """strategy_choose() in src/strategy.cpp."""
+    if not (dev.channel and dev.ip_epoch >= 0):
+        return "dhcp"  # no cache
+    if rng.random() * 100 < consts["STRATEGY_EXPLORE_PCT"]:
+        return rng.choice(STRATEGIES)
+    return min(STRATEGIES, key=lambda name: expected_ms(dev.stats[name], consts))
+
+
+def record_strategy(dev, name, success, ms, consts, rng):
+    """strategy_record() in src/strategy.cpp, with the STATS_SAMPLE_ONE_IN sampling."""
+    tries, wins, avg_ms = dev.stats[name]
+    weight = 1
+    if success and wins and abs(ms - avg_ms) <= consts["STRATEGY_ORDINARY_MS"]:
+        if rng.randrange(consts["STATS_SAMPLE_ONE_IN"]):
+            return
+        weight = consts["STATS_SAMPLE_ONE_IN"]
+    if tries + weight > consts["STRATEGY_MAX_TRIES"]:
+        tries, wins = tries // 2, wins // 2
+    tries += weight
+    if success:
+        ms = min(int(ms), 0xFFFF)
+        avg_ms = (3 * avg_ms + ms) // 4 if wins else ms
+        wins += weight
+    dev.stats[name] = [tries, wins, avg_ms]
+
+
+def simulate_press(now, net, dev, dist, probs, consts, rng):
+    """Runs one press, returns a dict with outcome, path, strategy, latency & energy."""
+    full_cal = not dev.rf_cal_countdown or dev.fail_streak >= consts["RF_CAL_MAX_FAILS"]
+    ms = {"boot": dist["boot"](), "cal": dist["rf_cal_full" if full_cal else "rf_cal_quick"](),
+          "settings": dist["settings_read"](), "wifi": 0.0, "send": 0.0}
+    t = 0.0  # since setup() started
+    path = "fast"
+    strategy = choose_strategy(dev, consts, rng)
+
+    def done(connected, reason=None):
+        """Counts calibrations like rf_cal_update() in src/rf_cal.cpp, returns the result."""
+        if connected:
+            dev.fail_streak = 0
+            dev.rf_cal_countdown = consts["RF_CAL_INTERVAL"] if full_cal else max(0, dev.rf_cal_countdown - 1)
+        else:
+            dev.fail_streak += 1
+        return {"ok": reason is None, "path": path, "strategy": strategy, "reason": reason,
+                "ms": t, "energy": ms}
+
+    # wifi_try_fast_connect(), with the BSSID pinned or only the channel
+    fast_ok = False
+    if strategy != "dhcp":
+        if strategy == "bssid":
+            cache_ok = dev.channel == net.channel and dev.bssid == net.bssid
+            assoc = dist["assoc_fast"]()
+        else:
+            cache_ok = dev.channel == net.channel
+            assoc = dist["assoc_fast"]() + dist["probe_channel"]()
+        timeout = budget(consts, t, "PLAN_WIFI_FAST")
+        if timeout and cache_ok and rng.random() >= probs["fast_fail"] and assoc < timeout:
+            t += assoc
+            fast_ok = True
+        else:
+            t += timeout
+        record_strategy(dev, strategy, fast_ok, assoc if fast_ok else timeout, consts, rng)
+    if not fast_ok:
+        # wifi_try_slow_connect(), then build_settings_from_wifi(); saved at the
+        # end if the cache changed
+        path = "slow"
+        timeout = budget(consts, t, "PLAN_WIFI_SLOW")
+        needed = dist["scan"]() + dist["assoc_slow"]() + dist["dhcp"]() + dist["dns"]()
+        slow_ok = timeout and rng.random() >= probs["slow_fail"] and needed <= timeout
+        if strategy == "dhcp":
+            record_strategy(dev, strategy, slow_ok, needed if slow_ok else timeout, consts, rng)
+        if not slow_ok:
+            t += timeout
+            ms["wifi"] = t
+            return done(False, "wifi")
+        t += needed
+        changed = (dev.channel, dev.bssid, dev.ip_epoch, dev.broker_ip) != \
+            (net.channel, net.bssid, net.ip_epoch, net.broker_ip)
+        dev.channel, dev.bssid, dev.ip_epoch = net.channel, net.bssid, net.ip_epoch
+        dev.broker_ip = net.broker_ip
+        if changed:
+            t += dist["flash_write"]()
+    ms["wifi"] = t
+
+    # mqtt_connect_server(): retry TCP connect until PRECONNECT_TIMEOUT
+    press_time = now + t
+    stale_ip = fast_ok and dev.ip_epoch != net.ip_epoch
+    stale_broker = dev.broker_ip != net.broker_ip
+    broker_down = press_time < net.broker_down_until
+    timeout = budget(consts, t, "PLAN_MQTT")
+    if stale_ip or stale_broker or broker_down or not timeout:
+        recovers_in = (net.broker_down_until - press_time) if (broker_down and not (stale_ip or stale_broker)) else None
+        if recovers_in is not None and recovers_in < timeout:
+            t += recovers_in + 50  # next retry after the broker is back
+        else:
+            t += timeout
+            ms["send"] = t - ms["wifi"]
+            reason = "stale_ip" if stale_ip else ("stale_broker" if stale_broker else "broker_down")
+            return done(True, reason)
+    t += dist["tcp_rtt"]() * 2 + dist["connack"]()  # connect
+    t += dist["tcp_rtt"]() / 2  # publish
+    ms["send"] = t - ms["wifi"]
+    return done(True)
+
+
+def energy_uah(ms, ok, consts):
+    """Charge per phase like energy_estimate() in src/energy.cpp, in uAh."""
+    def charge(t, current, tx_pct=0):
+        return t * (current * (100 - tx_pct) + consts["ENERGY_TX_MA"] * tx_pct) / 100 / 3600.0
+    blink = consts["BLINK_MS"] if ok else 0
+    steps = consts["BLINK_MS"] // consts["BLINK_STEP_MS"]
+    blink_on = (steps + 1) // 2 * consts["BLINK_STEP_MS"] if ok else 0
+    return {
+        "boot": charge(ms["boot"], consts["ENERGY_CPU_MA"]),
+        "cal": charge(ms["cal"], consts["ENERGY_TX_MA"]),
+        "settings": charge(ms["settings"], consts["ENERGY_CPU_MA"]),
+        "wifi": charge(ms["wifi"], consts["ENERGY_RX_MA"], consts["ENERGY_WIFI_TX_PCT"]),
+        "send": charge(ms["send"], consts["ENERGY_RX_MA"], consts["ENERGY_SEND_TX_PCT"]),
+        "blink": charge(blink, consts["ENERGY_IDLE_MA"]),
+        "led": charge(ms["settings"] + ms["wifi"] + ms["send"] + blink_on, consts["ENERGY_LED_MA"]),
+    }
+
+
+def run(args):
+    rng = random.Random(args.seed)
+    consts = read_firmware_defines()
+    for item in args.set:
+        key, _, value = item.partition("=")
+        consts[key] = int(value)
+    consts["phases"] = read_planner_phases(consts)
+    # press_deadline_ms; 0 = every phase with its full timeout, like planner_begin()
+    consts["deadline"] = args.deadline or sum(max_ms for _, max_ms, _ in consts["phases"].values())
+    params = dict(DEFAULT_PARAMS)
+    probs = dict(DEFAULT_PROBS)
+    for item in args.param:
+        key, _, value = item.partition("=")
+        if key in probs:
+            probs[key] = float(value)
+        else:
+            params[key] = value
+    dist = {key: make_dist(spec, rng) for key, spec in params.items()}
+
+    net = Network(dist)
+    dev = Device()
+    now = 0.0
+    results = []
+    for _ in range(args.presses):
+        now += dist["press_every"]() * 3600e3
+        net.advance(now)
+        result = simulate_press(now, net, dev, dist, probs, consts, rng)
+        results.append(result)
+        if not result["ok"] and rng.random() < probs["user_refresh"]:
+            # loop(): still pressed, so wifi_try_slow_connect() rebuilds the cache
+            dev.channel, dev.bssid, dev.ip_epoch = net.channel, net.bssid, net.ip_epoch
+            dev.broker_ip = net.broker_ip
+
+    ok = [r for r in results if r["ok"]]
+    latencies = [r["ms"] for r in ok]
+    reasons = {}
+    for r in results:
+        if not r["ok"]:
+            reasons[r["reason"]] = reasons.get(r["reason"], 0) + 1
+    phases = [energy_uah(r["energy"], r["ok"], consts) for r in results]
+    energy = [sum(p.values()) for p in phases]
+    return {
+        "presses": len(results),
+        "success_rate": len(ok) / len(results),
+        "slow_path_rate": sum(r["path"] == "slow" for r in results) / len(results),
+        "strategy_rate": {name: sum(r["strategy"] == name for r in results) / len(results) for name in STRATEGIES},
+        "failures": reasons,
+        "latency_ms": {f"p{p}": round(percentile(latencies, p), 1) for p in (50, 90, 95, 99)},
+        "energy_uah": {"mean": round(sum(energy) / len(energy), 2), "p99": round(percentile(energy, 99), 2),
+                       **{name: round(sum(p[name] for p in phases) / len(phases), 2) for name in ENERGY_PHASES}},
+        "timeouts": {k: consts.get(k) for k in ("FAST_TIMEOUT", "SLOW_TIMEOUT", "PRECONNECT_TIMEOUT",
+                                                "deadline")},
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--presses", type=int, default=5000)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--deadline", type=int, default=0, help="press_deadline_ms, 0 = none")
+    parser.add_argument("--set", action="append", default=[], metavar="DEFINE=VALUE",
+                        help="override a firmware #define, e.g. FAST_TIMEOUT=2000")
+    parser.add_argument("--param", action="append", default=[], metavar="NAME=DIST",
+                        help="override a model distribution or probability")
+    parser.add_argument("--json", action="store_true", help="machine-readable output")
+    args = parser.parse_args()
+
+    report = run(args)
+    if args.json:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+        return
+    print(f"presses:        {report['presses']}")
+    print(f"success rate:   {report['success_rate']*100:.2f}%")
+    print(f"slow path rate: {report['slow_path_rate']*100:.2f}%")
+    print("strategies:     " + "  ".join(f"{k} {v*100:.1f}%" for k, v in report["strategy_rate"].items()))
+    for reason, count in sorted(report["failures"].items()):
+        print(f"  failed, {reason}: {count}")
+    print("latency (ok):   " + "  ".join(f"{k} {v:.0f} ms" for k, v in report["latency_ms"].items()))
+    energy = report["energy_uah"]
+    print(f"energy/press:   mean {energy['mean']} uAh, p99 {energy['p99']} uAh")
+    print("  mean/phase:   " + "  ".join(f"{name} {energy[name]}" for name in ENERGY_PHASES))
+    print("timeouts:       " + "  ".join(f"{k}={v}" for k, v in report["timeouts"].items()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Stand-in for a device that a button triggers directly, e.g. WLED.
+
+Answers HTTP requests like WLED's JSON API does, and listens for UDP
+datagrams, printing when each press arrives. Set the button's "Direct
+trigger" to this machine, e.g. http://192.168.1.10:8080/json/state or
+udp://192.168.1.10:21324:
+
+    python3 tools/direct_standin.py [--http 8080] [--udp 21324]
+
+To compare with the broker path, also set an MQTT topic on the button and
+watch it here (needs mosquitto_sub); each press then shows how much later
+the MQTT message arrived than the direct one, with percentiles on Ctrl+C:
+
+    python3 tools/direct_standin.py --mqtt-host 192.168.1.5 --topic button/state
+"""
+
+import argparse
+import http.server
+import queue
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+from common import percentile
+
+events = queue.Queue()  # (monotonic time, kind, text)
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, *args):
+        pass
+
+    def _answer(self, body=b""):
+        events.put((time.monotonic(), "http", f"{self.command} {self.path} {body.decode(errors='replace')}"))
+        reply = b'{"success":true}'
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(reply)))
+        self.end_headers()
+        self.wfile.write(reply)
+
+    def do_GET(self):
+        self._answer()
+
+    def do_POST(self):
+        self._answer(self.rfile.read(int(self.headers.get("Content-Length", 0))))
+
+
+def udp_listener(port):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", port))
+    while True:
+        data, sender = sock.recvfrom(2048)
+        events.put((time.monotonic(), "udp", f"{sender[0]} {data!r}"))
+
+
+def mqtt_listener(args):
+    cmd = ["mosquitto_sub", "-h", args.mqtt_host, "-p", str(args.mqtt_port), "-t", args.topic, "-v"]
+    if args.user:
+        cmd += ["-u", args.user, "-P", args.password or ""]
+    with subprocess.Popen(cmd, stdout=subprocess.PIPE, text=True) as proc:
+        for line in proc.stdout:
+            events.put((time.monotonic(), "mqtt", line.strip()))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--http", type=int, default=8080, help="HTTP port, 0 = off")
+    parser.add_argument("--udp", type=int, default=21324, help="UDP port, 0 = off")
+    parser.add_argument("--mqtt-host", help="also watch --topic on this broker")
+    parser.add_argument("--mqtt-port", type=int, default=1883)
+    parser.add_argument("--topic", default="#")
+    parser.add_argument("-u", "--user")
+    parser.add_argument("-P", "--password")
+    parser.add_argument("--window", type=float, default=3.0, help="seconds an MQTT message may trail its press")
+    args = parser.parse_args()
+
+    if args.http:
+        server = http.server.ThreadingHTTPServer(("", args.http), Handler)
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+    if args.udp:
+        threading.Thread(target=udp_listener, args=(args.udp,), daemon=True).start()
+    if args.mqtt_host:
+        threading.Thread(target=mqtt_listener, args=(args,), daemon=True).start()
+    print(f"http/{args.http or '-'} udp/{args.udp or '-'}"
+          + (f", mqtt {args.mqtt_host} {args.topic}" if args.mqtt_host else ""), file=sys.stderr)
+
+    start = time.monotonic()
+    last_direct = None  # time of the last direct press without MQTT match yet
+    lags = []
+    try:
+        while True:
+            when, kind, text = events.get()
+            stamp = f"{when - start:9.3f}s"
+            if kind in ("http", "udp"):
+                last_direct = when
+                print(f"{stamp} {kind:<4} {text}")
+            elif last_direct is not None and when - last_direct <= args.window:
+                lag = (when - last_direct) * 1000
+                lags.append(lag)
+                last_direct = None
+                print(f"{stamp} mqtt {text}  (+{lag:.0f} ms after direct)")
+            else:
+                print(f"{stamp} mqtt {text}")
+    except KeyboardInterrupt:
+        pass
+    if lags:
+        print(f"\nMQTT later than direct, {len(lags)} presses: "
+              + "  ".join(f"p{p} {percentile(lags, p):.0f} ms" for p in (50, 90, 99)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Decode the device's buffered debug log (DEBUG_LOG_RING) using the .elf file.
+
+Each record holds a time, the flash address of the DEBUG_LOG() text and the
+value of DEBUG_LOG1() (see src/log_ring.h); the texts themselves never
+leave the device.
+Listen for the packets sent with DEBUG_LOG_UDP_HOST set to this machine:
+
+    python3 tools/log_decode.py .pio/build/esp01/firmware.elf [--port 5514]
+
+or decode packets saved earlier, one after the other, in a file:
+
+    python3 tools/log_decode.py .pio/build/esp01/firmware.elf --file log.bin
+"""
+
+import argparse
+import socket
+import struct
+import sys
+
+MAGIC = b"SPLR"
+HEADER = struct.Struct("<4sHH")  # magic, records, dropped
+RECORD = struct.Struct("<IIi")   # ms, text address, value
+NO_ARG = -0x80000000              # LOG_RING_NO_ARG, a DEBUG_LOG() without value
+SHT_NOBITS = 8
+
+
+class ElfStrings:
+    """Reads C strings at virtual addresses of a 32-bit little-endian ELF."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError(f"{path}: not a 32-bit little-endian ELF file")
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", self.data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            _, sh_type, _, addr, offset, size = struct.unpack_from("<IIIIII", self.data, shoff + i * shentsize)
+            if addr and size and sh_type != SHT_NOBITS:
+                self.sections.append((addr, offset, size))
+
+    def string(self, addr):
+        for start, offset, size in self.sections:
+            if start <= addr < start + size:
+                pos = offset + addr - start
+                end = self.data.find(b"\0", pos, offset + size)
+                return self.data[pos:end if end >= 0 else offset + size].decode("utf-8", "replace")
+        return f"<unknown text @ 0x{addr:08x}>"
+
+
+def decode_packet(packet, strings, out):
+    """Prints one packet's records like DEBUG_LOG does, returns bytes used."""
+    if len(packet) < HEADER.size or packet[:4] != MAGIC:
+        return 0
+    _, count, dropped = HEADER.unpack_from(packet)
+    pos = HEADER.size
+    for _ in range(count):
+        if pos + RECORD.size > len(packet):
+            break
+        ms, addr, value = RECORD.unpack_from(packet, pos)
+        pos += RECORD.size
+        line = f"{strings.string(addr)} @ {ms}"
+        out.write(line + (f" = {value}\n" if value != NO_ARG else "\n"))
+    if dropped:
+        out.write(f"Log ring full, dropped: {dropped}\n")
+    out.flush()
+    return pos
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware.elf of the build running on the device")
+    parser.add_argument("--port", type=int, default=5514, help="UDP port to listen on")
+    parser.add_argument("--file", help="decode saved packets instead of listening")
+    args = parser.parse_args()
+
+    strings = ElfStrings(args.elf)
+    if args.file:
+        with open(args.file, "rb") as f:
+            data = f.read()
+        while data:
+            used = decode_packet(data, strings, sys.stdout)
+            if not used:
+                sys.exit("not a log packet, stopping")
+            data = data[used:]
+        return
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", args.port))
+    print(f"listening on udp/{args.port}", file=sys.stderr)
+    while True:
+        packet, sender = sock.recvfrom(4096)
+        print(f"# from {sender[0]}", file=sys.stderr)
+        decode_packet(packet, strings, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
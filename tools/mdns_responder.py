@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Minimal mDNS responder stand-in, for trying out the device's .local lookups.
+
+Answers A queries for one name with one IP address, either to the sender's
+port (legacy one-shot queries, as sent by the device) or to the multicast
+group. Run it on a machine in the same network as the button:
+
+    python3 tools/mdns_responder.py homeassistant.local 192.168.1.5 [--delay 200]
+
+--delay adds a response delay in ms, to check the device's timeout handling.
+"""
+
+import argparse
+import socket
+import struct
+import time
+
+MDNS_GROUP = "224.0.0.251"
+MDNS_PORT = 5353
+
+
+def read_name(packet, pos):
+    """Returns (name, position after name), following compression pointers."""
+    labels = []
+    end = None
+    while True:
+        length = packet[pos]
+        if length & 0xC0 == 0xC0:
+            if end is None:
+                end = pos + 2
+            pos = ((length & 0x3F) << 8) | packet[pos + 1]
+            continue
+        pos += 1
+        if length == 0:
+            break
+        labels.append(packet[pos:pos + length].decode("ascii", "replace"))
+        pos += length
+    return ".".join(labels), (end if end is not None else pos)
+
+
+def build_answer(query_id, question, name, ip, ttl):
+    header = struct.pack(">HHHHHH", query_id, 0x8400, 1, 1, 0, 0)
+    # answer points back at the question's name (offset 12)
+    answer = struct.pack(">HHHIH", 0xC00C, 1, 0x8001, ttl, 4) + socket.inet_aton(ip)
+    return header + question + answer
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("name")
+    parser.add_argument("ip")
+    parser.add_argument("--ttl", type=int, default=120)
+    parser.add_argument("--delay", type=int, default=0, help="response delay in ms")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, "SO_REUSEPORT"):
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    sock.bind(("", MDNS_PORT))
+    mreq = struct.pack("4s4s", socket.inet_aton(MDNS_GROUP), socket.inet_aton("0.0.0.0"))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+
+    print(f"Answering {args.name} -> {args.ip} on {MDNS_GROUP}:{MDNS_PORT}")
+    while True:
+        packet, sender = sock.recvfrom(1500)
+        if len(packet) < 12:
+            continue
+        query_id, flags, questions = struct.unpack(">HHH", packet[:6])
+        if flags & 0x8000 or questions < 1:
+            continue  # a response, or nothing asked
+        name, pos = read_name(packet, 12)
+        qtype, qclass = struct.unpack(">HH", packet[pos:pos + 4])
+        if name.lower() != args.name.lower() or qtype != 1:
+            continue
+        if args.delay:
+            time.sleep(args.delay / 1000)
+        reply = build_answer(query_id, packet[12:pos + 4], name, args.ip, args.ttl)
+        # legacy queries (source port != 5353) get a unicast reply
+        target = sender if sender[1] != MDNS_PORT else (MDNS_GROUP, MDNS_PORT)
+        sock.sendto(reply, target)
+        print(f"{time.strftime('%H:%M:%S')} {sender[0]}:{sender[1]} asked for {name}, replied")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Collect the buttons' per-press metrics and show latency percentiles.
+
+Set "Metrics host" in the device's setup page to the machine running this,
+then each press sends one InfluxDB line-protocol datagram (see src/metrics.cpp):
+
+    python3 tools/metrics_receiver.py [--port 8089] [--every 60] [--by device]
+
+Prints a table every --every seconds and on Ctrl+C. --by groups the rows by
+a tag (device, path or strategy); --log appends the raw lines to a file,
+and --file reads such a file instead of listening.
+"""
+
+import argparse
+import socket
+import sys
+import time
+
+from common import percentile
+
+PERCENTILES = (50, 90, 95, 99)
+
+
+def split_unescaped(text, sep):
+    """Splits at sep, except where it's escaped with a backslash."""
+    parts, current, escaped = [], "", False
+    for ch in text:
+        if escaped:
+            current += ch
+            escaped = False
+        elif ch == "\\":
+            escaped = True
+        elif ch == sep:
+            parts.append(current)
+            current = ""
+        else:
+            current += ch
+    parts.append(current)
+    return parts
+
+
+def parse_line(line):
+    """Returns (measurement, tags, fields) for one line, or None."""
+    parts = split_unescaped(line.strip(), " ")
+    if len(parts) < 2:
+        return None
+    series = split_unescaped(parts[0], ",")
+    tags = dict(t.split("=", 1) for t in series[1:] if "=" in t)
+    fields = {}
+    for item in split_unescaped(parts[1], ","):
+        key, _, value = item.partition("=")
+        try:
+            fields[key] = float(value.rstrip("iu"))
+        except ValueError:
+            pass  # strings & booleans aren't aggregated
+    return series[0], tags, fields
+
+
+class Stats:
+    def __init__(self, by):
+        self.by = by
+        self.groups = {}  # group -> field -> [values]
+        self.slow = {}    # group -> presses that needed a slow connect
+
+    def add(self, line):
+        parsed = parse_line(line)
+        if not parsed:
+            return
+        _, tags, fields = parsed
+        group = tags.get(self.by, "?") if self.by else "all"
+        for key, value in fields.items():
+            self.groups.setdefault(group, {}).setdefault(key, []).append(value)
+        self.slow[group] = self.slow.get(group, 0) + (tags.get("path") == "slow")
+
+    def report(self, out):
+        header = f"{'group':<16} {'field':<20} {'n':>6} " + " ".join(f"{'p%d' % p:>8}" for p in PERCENTILES)
+        out.write(header + "\n")
+        for group in sorted(self.groups):
+            fields = self.groups[group]
+            presses = len(fields.get("total_ms", []))
+            ok = sum(fields.get("ok", []))
+            pct = 100.0 / presses if presses else 0.0
+            out.write(f"{group:<16} presses {presses}, ok {ok * pct:.1f}%, slow path {self.slow[group] * pct:.1f}%\n")
+            for key in sorted(fields):
+                if not key.endswith(("_ms", "_uah")) and key not in ("rssi", "mqtt_tries", "heap"):
+                    continue
+                values = fields[key]
+                digits = 1 if key.endswith("_uah") else 0
+                row = " ".join(f"{percentile(values, p):>8.{digits}f}" for p in PERCENTILES)
+                out.write(f"{'':<16} {key:<20} {len(values):>6} {row}\n")
+        out.write("\n")
+        out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8089)
+    parser.add_argument("--every", type=float, default=60, help="seconds between reports")
+    parser.add_argument("--by", choices=("device", "path", "strategy"), help="group by this tag")
+    parser.add_argument("--log", help="append received lines to this file")
+    parser.add_argument("--file", help="read lines from this file instead of listening")
+    args = parser.parse_args()
+
+    stats = Stats(args.by)
+    if args.file:
+        with open(args.file) as f:
+            for line in f:
+                stats.add(line)
+        stats.report(sys.stdout)
+        return
+
+    log = open(args.log, "a") if args.log else None
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", args.port))
+    sock.settimeout(1.0)
+    print(f"listening on udp/{args.port}", file=sys.stderr)
+    next_report = time.monotonic() + args.every
+    try:
+        while True:
+            try:
+                packet, _ = sock.recvfrom(2048)
+                for line in packet.decode("utf-8", "replace").splitlines():
+                    stats.add(line)
+                    if log:
+                        log.write(line + "\n")
+                        log.flush()
+            except socket.timeout:
+                pass
+            if time.monotonic() >= next_report:
+                stats.report(sys.stdout)
+                next_report = time.monotonic() + args.every
+    except KeyboardInterrupt:
+        stats.report(sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Update a button's firmware through its setup page (AP mode).
+
+Join the button's access point ("AP_xxxxxx"), then:
+
+    python3 tools/ota_push.py .pio/build/esp01/firmware.bin --password secret [--ip 192.168.4.1]
+
+The password is the "Firmware update password" of the setup page; the
+button refuses updates while none is set.
+
+The image is gzip-compressed (unless it already is), and uploaded to
+/update with its size and MD5, so the button only installs a complete,
+matching image. If the connection drops, the upload continues where the
+button's GET /update says it stopped. --part sends the image in several
+uploads of that many bytes, so a drop loses less. Prints the throughput.
+"""
+
+import argparse
+import gzip
+import hashlib
+import http.client
+import re
+import sys
+import time
+import urllib.parse
+import uuid
+
+RESULT = re.compile(r"(\w+) offset=(\d+) size=(\d+) bytes=(\d+) ms=(\d+) rate=(\d+)")
+
+
+def device_offset(ip, size, timeout):
+    """Where a running upload of this size stands on the device, or 0."""
+    conn = http.client.HTTPConnection(ip, timeout=timeout)
+    try:
+        conn.request("GET", "/update")
+        text = conn.getresponse().read().decode()
+    finally:
+        conn.close()
+    match = re.search(r"offset=(\d+) size=(\d+)", text)
+    if match and int(match.group(2)) == size:
+        return int(match.group(1))
+    return 0
+
+
+def upload(ip, image, offset, end, digest, password, timeout):
+    """Sends image[offset:end] as one multipart upload, returns the reply."""
+    boundary = uuid.uuid4().hex
+    head = (f"--{boundary}\r\n"
+            'Content-Disposition: form-data; name="image"; filename="firmware.bin.gz"\r\n'
+            "Content-Type: application/octet-stream\r\n\r\n").encode()
+    tail = f"\r\n--{boundary}--\r\n".encode()
+    path = f"/update?size={len(image)}&md5={digest}&offset={offset}&password={urllib.parse.quote(password)}"
+    conn = http.client.HTTPConnection(ip, timeout=timeout)
+    try:
+        conn.putrequest("POST", path)
+        conn.putheader("Content-Type", f"multipart/form-data; boundary={boundary}")
+        conn.putheader("Content-Length", str(len(head) + (end - offset) + len(tail)))
+        conn.endheaders()
+        conn.send(head)
+        for pos in range(offset, end, 1460):
+            conn.send(image[pos:min(pos + 1460, end)])
+        conn.send(tail)
+        return conn.getresponse().read().decode()
+    finally:
+        conn.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", help="firmware.bin, or firmware.bin.gz")
+    parser.add_argument("--ip", default="192.168.4.1")
+    parser.add_argument("--password", required=True, help="firmware update password set on the setup page")
+    parser.add_argument("--part", type=int, default=0, help="bytes per upload (default: all at once)")
+    parser.add_argument("--retries", type=int, default=5)
+    parser.add_argument("--timeout", type=float, default=20.0)
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        data = f.read()
+    image = data if data[:2] == b"\x1f\x8b" else gzip.compress(data, 9)
+    digest = hashlib.md5(image).hexdigest()
+    print(f"{args.image}: {len(data)} bytes, sending {len(image)} bytes, md5 {digest}", file=sys.stderr)
+
+    start = time.monotonic()
+    offset = 0
+    retries = args.retries
+    while True:
+        end = min(len(image), offset + args.part) if args.part else len(image)
+        try:
+            reply = upload(args.ip, image, offset, end, digest, args.password, args.timeout)
+        except (OSError, http.client.HTTPException) as err:
+            if not retries:
+                sys.exit(f"upload failed: {err}")
+            retries -= 1
+            time.sleep(1)
+            try:
+                offset = device_offset(args.ip, len(image), args.timeout)
+            except (OSError, http.client.HTTPException):
+                pass  # try the same part again
+            print(f"connection dropped ({err}), resuming at {offset}", file=sys.stderr)
+            continue
+        match = RESULT.search(reply)
+        if not match:
+            sys.exit(f"unexpected reply: {reply.strip()}")
+        state, before, offset = match.group(1), offset, int(match.group(2))
+        print(f"{state}: {offset}/{len(image)} bytes, this part {match.group(4)} bytes "
+              f"in {match.group(5)} ms, {int(match.group(6)) / 1024:.1f} kB/s", file=sys.stderr)
+        if state == "error":
+            sys.exit(reply.strip())
+        if state == "done":
+            break
+        if offset <= before:
+            if not retries:
+                sys.exit("no progress, giving up")
+            retries -= 1
+    seconds = time.monotonic() - start
+    print(f"updated in {seconds:.1f} s, {len(image) / 1024 / seconds:.1f} kB/s overall; the button reboots now")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Measure how fast the setup page answers each OS's captive-portal check.
+
+Join the button's access point ("AP_xxxxxx") with a laptop, then:
+
+    python3 tools/portal_probe.py [--ip 192.168.4.1] [--repeat 10]
+
+For each OS, sends its probe the way the OS does (its own Host header),
+checks that the answer would make the OS show a portal, follows it to
+the setup page, and reports the time from the probe to the page. One
+keep-alive connection is used per OS, as long as the device keeps it
+open; the number of connections needed is shown too.
+"""
+
+import argparse
+import http.client
+import json
+import re
+import sys
+import time
+
+from common import percentile
+
+# host, path, what a connected network would answer
+PROBES = {
+    "android": ("connectivitycheck.gstatic.com", "/generate_204", "status 204"),
+    "apple": ("captive.apple.com", "/hotspot-detect.html", "body with Success"),
+    "windows": ("www.msftconnecttest.com", "/connecttest.txt", "Microsoft Connect Test"),
+    "windows-old": ("www.msftncsi.com", "/ncsi.txt", "Microsoft NCSI"),
+    "firefox": ("detectportal.firefox.com", "/success.txt", "success"),
+}
+
+
+class Session:
+    """Keep-alive connection that reconnects when the device closes it."""
+
+    def __init__(self, ip, timeout):
+        self.ip, self.timeout = ip, timeout
+        self.conn = None
+        self.connections = 0
+
+    def get(self, host, path):
+        for attempt in (0, 1):
+            if self.conn is None:
+                self.conn = http.client.HTTPConnection(self.ip, timeout=self.timeout)
+                self.connections += 1
+            try:
+                self.conn.request("GET", path, headers={"Host": host, "Connection": "keep-alive"})
+                resp = self.conn.getresponse()
+                body = resp.read()
+                if resp.getheader("Connection", "").lower() == "close":
+                    self.close()
+                return resp.status, resp.getheader("Location"), body
+            except (http.client.HTTPException, ConnectionError, OSError):
+                self.close()
+                if attempt:
+                    raise
+
+    def close(self):
+        if self.conn:
+            self.conn.close()
+        self.conn = None
+
+
+def portal_target(status, location, body, expected):
+    """Where the OS would go next, or None if it thinks it's online."""
+    if status == 204 or (status == 200 and expected.split()[-1].encode() in body and b"refresh" not in body):
+        return None
+    if status in (301, 302, 303, 307) and location:
+        return location
+    match = re.search(rb'url=([^"\'>]+)', body)
+    return match.group(1).decode() if match else "/"
+
+
+def run_once(ip, name, timeout):
+    host, path, expected = PROBES[name]
+    session = Session(ip, timeout)
+    start = time.monotonic()
+    status, location, body = session.get(host, path)
+    probe_ms = (time.monotonic() - start) * 1000
+    target = portal_target(status, location, body, expected)
+    if target is None:
+        session.close()
+        return {"ok": False, "status": status, "probe_ms": probe_ms}
+    # the portal page, on the device's own address
+    page = re.sub(r"^https?://[^/]+", "", target) or "/"
+    status, _, body = session.get(ip, page)
+    total_ms = (time.monotonic() - start) * 1000
+    session.close()
+    return {"ok": status == 200 and b"<form" in body, "status": status, "probe_ms": probe_ms,
+            "portal_ms": total_ms, "connections": session.connections}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--ip", default="192.168.4.1")
+    parser.add_argument("--repeat", type=int, default=5)
+    parser.add_argument("--timeout", type=float, default=10.0)
+    parser.add_argument("--os", action="append", choices=sorted(PROBES), help="only these (default: all)")
+    parser.add_argument("--json", action="store_true")
+    args = parser.parse_args()
+
+    report = {}
+    for name in args.os or PROBES:
+        runs = []
+        for _ in range(args.repeat):
+            try:
+                runs.append(run_once(args.ip, name, args.timeout))
+            except OSError as err:
+                runs.append({"ok": False, "error": str(err)})
+        good = [r["portal_ms"] for r in runs if r["ok"]]
+        report[name] = {
+            "ok": len(good), "runs": len(runs),
+            "portal_ms_p50": round(percentile(good, 50), 1) if good else None,
+            "portal_ms_max": round(max(good), 1) if good else None,
+            "connections": max((r.get("connections", 0) for r in runs), default=0),
+        }
+    if args.json:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+        return
+    for name, r in report.items():
+        times = f"p50 {r['portal_ms_p50']} ms, max {r['portal_ms_max']} ms" if r["ok"] else "no portal"
+        print(f"{name:<12} {r['ok']}/{r['runs']} ok  {times}  connections {r['connections']}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,68 @@
+"""PlatformIO extra script, adds a "size_report" target to each profile.
+
+    pio run -t size_report
+    pio run -t size_report -e esp01 -e esp01_mqtt -e esp01_rest
+
+Prints the firmware image size against the space for an update over the
+air: the running image & the new one both have to fit in the flash before
+the file system area, as placed by the flash layout in platformio.ini
+(board_build.ldscript). Also shows the RAM used by static data.
+"""
+
+import os
+import struct
+
+Import("env")  # noqa: F821 - provided by PlatformIO
+
+FLASH_BASE = 0x40200000
+SECTOR = 4096
+SHT_SYMTAB = 2
+
+
+def read_elf(path):
+    """Returns ({section name: size}, {symbol name: value}) of a 32-bit ELF."""
+    with open(path, "rb") as f:
+        data = f.read()
+    shoff, = struct.unpack_from("<I", data, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x2E)
+    headers = [struct.unpack_from("<IIIIIIIIII", data, shoff + i * shentsize) for i in range(shnum)]
+
+    def name_at(strtab, offset):
+        start = headers[strtab][4] + offset
+        return data[start:data.index(b"\0", start)].decode()
+
+    sections = {name_at(shstrndx, h[0]): h[5] for h in headers}
+    symbols = {}
+    for h in headers:
+        if h[1] != SHT_SYMTAB:
+            continue
+        for pos in range(h[4], h[4] + h[5], 16):
+            name, value = struct.unpack_from("<II", data, pos)
+            if name:
+                symbols[name_at(h[6], name)] = value
+    return sections, symbols
+
+
+def size_report(source, target, env):
+    sections, symbols = read_elf(env.subst("$BUILD_DIR/${PROGNAME}.elf"))
+    image = os.path.getsize(env.subst("$BUILD_DIR/${PROGNAME}.bin"))
+    # the linker placed these from the pinned layout
+    space = symbols["_FS_start"] - FLASH_BASE
+    layout = env.GetProjectOption("board_build.ldscript", "the board's default layout")
+    fs_note = "" if symbols["_FS_end"] > symbols["_FS_start"] else \
+        ", no file system area: settings are written in place"
+    # like ESP.getFreeSketchSpace(): the running image, rounded up to sectors
+    free = space - (image + SECTOR - 1) // SECTOR * SECTOR
+    ram = sum(sections.get(name, 0) for name in (".data", ".rodata", ".bss"))
+    verdict = "fits" if image <= free else f"{image - free} bytes too big"
+    print(f"{env['PIOENV']}: image {image} bytes, OTA space {free} bytes ({verdict}) "
+          f"with {layout}{fs_note}, static RAM {ram} bytes")
+
+
+env.AddCustomTarget(  # noqa: F821
+    name="size_report",
+    dependencies="$BUILD_DIR/${PROGNAME}.bin",
+    actions=size_report,
+    title="Size report",
+    description="Image size vs. the space for an OTA update",
+)